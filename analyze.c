@@ -0,0 +1,329 @@
+/*
+ * Solve deals in bulk on every core, to tune the deal generator and to catch
+ * rule changes that make deals unsolvable. Deals are numbered from the first
+ * one asked for:
+ *
+ *   by default deal n is the cards make_deck() uses, shuffled by splitmix64
+ *   seeded with n, so there are as many as wanted
+ *   with -g deal n is the game's own seed n, as make_deck() shuffles it
+ *
+ *     make analyze && ./shenzhen-analyze [-g] [-j threads] [deals] [first deal] [node limit]
+ *
+ * Each thread has its own solver, whose position table it keeps from deal
+ * to deal, and its own range of deals. One that runs out takes the top half
+ * of the biggest range left. Prints how many were solved, a histogram of
+ * solution lengths and the deals solved per second. Solutions aren't
+ * replayed through game.c, which isn't thread safe; shenzhen-solve does
+ * that.
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "deck.h"
+#include "solver.h"
+
+#define MAX_THREADS 256
+#define NUM_GAME_SEEDS  0x10000
+
+/* Solution lengths per histogram bar, and the longest bar drawn */
+#define HIST_STEP   10
+#define HIST_BARS   (SOLVER_MAX_MOVES / HIST_STEP + 1)
+#define HIST_WIDTH  50
+
+struct stats {
+    unsigned long deals;
+    unsigned long solved;
+    unsigned long unsolvable;
+    unsigned long gave_up;
+    unsigned long nodes;
+    unsigned long worst;
+    unsigned long moves;
+    unsigned long lengths[HIST_BARS];
+};
+
+struct worker {
+    pthread_t thread;
+    /* Guards next and end, which other workers take deals from */
+    pthread_mutex_t lock;
+    uint64_t next;
+    uint64_t end;
+    struct stats stats;
+};
+
+static struct worker workers[MAX_THREADS];
+static unsigned num_workers;
+static unsigned long max_nodes = 1000000;
+static bool game_seeds;
+
+/* make_deck() shuffles with a static LFSR */
+static pthread_mutex_t deck_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t x = *state += 0x9e3779b97f4a7c15ull;
+
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static void deal_deck(card_t *deck, uint64_t n)
+{
+    uint64_t state = n;
+    unsigned i, pick;
+    card_t tmp;
+
+    if (game_seeds) {
+        pthread_mutex_lock(&deck_lock);
+        make_deck(deck, (uint16_t)n);
+        pthread_mutex_unlock(&deck_lock);
+        return;
+    }
+
+    /* Fisher-Yates; the modulo bias of a 64 bit draw is too small to matter */
+    deck_cards(deck);
+    for (i = DECK_SIZE - 1; i > 0; i--) {
+        pick = splitmix64(&state) % (i + 1);
+        tmp = deck[i];
+        deck[i] = deck[pick];
+        deck[pick] = tmp;
+    }
+}
+
+/* Take the top half of the biggest range another worker has left */
+static bool steal_deal(struct worker *w, uint64_t *n)
+{
+    struct worker *victim;
+    uint64_t left, most, half;
+    unsigned i;
+
+    for (;;) {
+        victim = NULL;
+        most = 0;
+        for (i = 0; i < num_workers; i++) {
+            if (&workers[i] == w)
+                continue;
+            pthread_mutex_lock(&workers[i].lock);
+            left = workers[i].end - workers[i].next;
+            pthread_mutex_unlock(&workers[i].lock);
+            if (left > most) {
+                most = left;
+                victim = &workers[i];
+            }
+        }
+        if (!victim)
+            return false;
+
+        /* It may have run down since */
+        pthread_mutex_lock(&victim->lock);
+        left = victim->end - victim->next;
+        half = (left + 1) / 2;
+        victim->end -= half;
+        pthread_mutex_unlock(&victim->lock);
+        if (!half)
+            continue;
+
+        pthread_mutex_lock(&w->lock);
+        *n = victim->end;
+        w->next = victim->end + 1;
+        w->end = victim->end + half;
+        pthread_mutex_unlock(&w->lock);
+        return true;
+    }
+}
+
+static bool take_deal(struct worker *w, uint64_t *n)
+{
+    bool have;
+
+    pthread_mutex_lock(&w->lock);
+    have = w->next < w->end;
+    if (have)
+        *n = w->next++;
+    pthread_mutex_unlock(&w->lock);
+    return have || steal_deal(w, n);
+}
+
+static void count(struct stats *st, const struct solution *sol)
+{
+    st->deals++;
+    st->nodes += sol->nodes;
+    if (sol->nodes > st->worst)
+        st->worst = sol->nodes;
+    if (sol->solved) {
+        st->solved++;
+        st->moves += sol->length;
+        st->lengths[sol->length / HIST_STEP]++;
+    } else if (sol->gave_up) {
+        st->gave_up++;
+    } else {
+        st->unsolvable++;
+    }
+}
+
+static void *work(void *arg)
+{
+    struct worker *w = arg;
+    struct solver *s = solver_new(max_nodes);
+    struct solution *sol = malloc(sizeof(*sol));
+    card_t deck[DECK_SIZE];
+    struct board b;
+    uint64_t n;
+
+    if (!s || !sol) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    while (take_deal(w, &n)) {
+        deal_deck(deck, n);
+        board_deal(&b, deck);
+        board_auto_moves(&b);
+        solve(s, &b, sol);
+        count(&w->stats, sol);
+    }
+    free(sol);
+    solver_free(s);
+    return NULL;
+}
+
+static void add_stats(struct stats *total, const struct stats *st)
+{
+    unsigned i;
+
+    total->deals += st->deals;
+    total->solved += st->solved;
+    total->unsolvable += st->unsolvable;
+    total->gave_up += st->gave_up;
+    total->nodes += st->nodes;
+    if (st->worst > total->worst)
+        total->worst = st->worst;
+    total->moves += st->moves;
+    for (i = 0; i < HIST_BARS; i++)
+        total->lengths[i] += st->lengths[i];
+}
+
+static void print_histogram(const struct stats *st)
+{
+    unsigned long most = 0;
+    unsigned first = HIST_BARS, last = 0;
+    unsigned i, width;
+
+    for (i = 0; i < HIST_BARS; i++) {
+        if (!st->lengths[i])
+            continue;
+        if (first == HIST_BARS)
+            first = i;
+        last = i;
+        if (st->lengths[i] > most)
+            most = st->lengths[i];
+    }
+    if (!most)
+        return;
+
+    printf("lengths:\n");
+    for (i = first; i <= last; i++) {
+        width = (unsigned)((st->lengths[i] * HIST_WIDTH + most - 1) / most);
+        printf("  %3u-%-3u %-*.*s %lu (%.1f%%)\n", i * HIST_STEP, i * HIST_STEP + HIST_STEP - 1,
+               HIST_WIDTH, width, "##################################################",
+               st->lengths[i], 100.0 * st->lengths[i] / st->solved);
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long deals = 100000;
+    uint64_t first = 1;
+    struct stats total;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t at;
+    unsigned i;
+    double secs;
+
+    num_workers = cores > 0 ? (unsigned)cores : 1;
+    while (argc > 1 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-g") == 0) {
+            game_seeds = true;
+        } else if (strcmp(argv[1], "-j") == 0 && argc > 2) {
+            num_workers = strtoul(argv[2], NULL, 0);
+            argv++;
+            argc--;
+        } else {
+            fprintf(stderr, "usage: %s [-g] [-j threads] [deals] [first deal] [node limit]\n", argv[0]);
+            return 1;
+        }
+        argv++;
+        argc--;
+    }
+    if (argc > 1)
+        deals = strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        first = strtoull(argv[2], NULL, 0);
+    if (argc > 3)
+        max_nodes = strtoul(argv[3], NULL, 0);
+
+    if (!deals) {
+        fprintf(stderr, "no deals to analyze\n");
+        return 1;
+    }
+    if (!num_workers || num_workers > MAX_THREADS) {
+        fprintf(stderr, "threads must be 1 to %d\n", MAX_THREADS);
+        return 1;
+    }
+    if (game_seeds && (first >= NUM_GAME_SEEDS || deals > NUM_GAME_SEEDS - first)) {
+        fprintf(stderr, "the game only has seeds 0 to 0x%x\n", NUM_GAME_SEEDS - 1);
+        return 1;
+    }
+    if (num_workers > deals)
+        num_workers = deals;
+
+    /* An even share each to start with */
+    at = first;
+    for (i = 0; i < num_workers; i++) {
+        pthread_mutex_init(&workers[i].lock, NULL);
+        workers[i].next = at;
+        at = first + deals * (i + 1) / num_workers;
+        workers[i].end = at;
+    }
+
+    secs = now();
+    for (i = 0; i < num_workers; i++) {
+        if (pthread_create(&workers[i].thread, NULL, work, &workers[i])) {
+            fprintf(stderr, "can't start a thread\n");
+            return 1;
+        }
+    }
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < num_workers; i++) {
+        pthread_join(workers[i].thread, NULL);
+        add_stats(&total, &workers[i].stats);
+    }
+    secs = now() - secs;
+
+    printf("deals:      %lu\n", total.deals);
+    printf("threads:    %u\n", num_workers);
+    printf("solved:     %lu (%.1f%%)\n", total.solved, 100.0 * total.solved / total.deals);
+    printf("unsolvable: %lu\n", total.unsolvable);
+    printf("gave up:    %lu\n", total.gave_up);
+    if (total.solved)
+        printf("moves:      %.1f per solution\n", (double)total.moves / total.solved);
+    printf("nodes:      %.0f per deal, %lu worst\n", (double)total.nodes / total.deals, total.worst);
+    printf("rate:       %.0f deals per second\n", total.deals / secs);
+    print_histogram(&total);
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+#
+# Cycle counts for the hot routines, measured in VICE.
+#
+# Runs the bench build (main.c with -DBENCH) in x64sc with the remote
+# monitor enabled. Each routine listed below gets a breakpoint on its label
+# from the ld65 label file. When one is hit the script reads the return
+# address off the stack, resets the stopwatch, runs 'until' the return
+# address and reads the stopwatch again. Other breakpoints are disabled
+# meanwhile, so callers are measured inclusive of their callees.
+#
+# The counts are real machine cycles, so they include badline DMA and any
+# raster interrupt that fires during the routine.
+#
+# Usage: bench.py PROGRAM LABELS OUTPUT.json
+
+import json
+import re
+import socket
+import subprocess
+import sys
+import time
+
+ROUTINES = [
+    "cards",
+    "draw_stack",
+    "check_moves",
+    "sprite_run_personify",
+    "joy2_process",
+    "frame_irq",
+]
+
+X64SC = "x64sc"
+PORT = 6510
+# Safety net: give up after 60 emulated seconds
+LIMIT_CYCLES = 60 * 985248
+
+PROMPT = re.compile(rb"\(C:\$([0-9a-f]{4})\) $")
+
+
+def load_labels(path):
+    labels = {}
+    with open(path) as f:
+        for line in f:
+            # al 00080D ._main
+            parts = line.split()
+            if len(parts) == 3 and parts[0] == "al":
+                labels[parts[2].lstrip(".")] = int(parts[1], 16)
+    return labels
+
+
+class Monitor:
+    def __init__(self, port):
+        for _ in range(100):
+            try:
+                self.sock = socket.create_connection(("127.0.0.1", port))
+                break
+            except OSError:
+                time.sleep(0.1)
+        else:
+            raise SystemExit("could not connect to the VICE monitor")
+        self.buf = b""
+
+    def wait_prompt(self):
+        """Read until the monitor prompt. Returns (pc, output)."""
+        while True:
+            m = PROMPT.search(self.buf)
+            if m:
+                out = self.buf[:m.start()].decode("ascii", "replace")
+                self.buf = self.buf[m.end():]
+                return int(m.group(1), 16), out
+            data = self.sock.recv(4096)
+            if not data:
+                return None, self.buf.decode("ascii", "replace")
+            self.buf += data
+
+    def cmd(self, line):
+        self.sock.sendall(line.encode("ascii") + b"\n")
+        return self.wait_prompt()[1]
+
+    def go(self):
+        self.sock.sendall(b"x\n")
+
+
+def stopwatch(mon):
+    return int(re.findall(r"\d+", mon.cmd("sw"))[-1])
+
+
+def main():
+    program, label_file, output = sys.argv[1:4]
+    labels = load_labels(label_file)
+    entry = {}
+    for name in ROUTINES:
+        if "_" + name not in labels:
+            raise SystemExit("no label for %s in %s" % (name, label_file))
+        entry[labels["_" + name]] = name
+
+    vice = subprocess.Popen([
+        X64SC, "-default", "-warp", "-debugcart",
+        "-limitcycles", str(LIMIT_CYCLES),
+        "-remotemonitor", "-remotemonitoraddress", "ip4://127.0.0.1:%d" % PORT,
+        "-autostartprgmode", "1", "-autostart", program,
+    ])
+
+    mon = Monitor(PORT)
+    # Entering the monitor stops the machine
+    mon.cmd("r")
+    checkpoints = []
+    for addr in entry:
+        out = mon.cmd("break $%04x" % addr)
+        checkpoints.append(int(re.search(r"BREAK:\s*(\d+)", out).group(1)))
+
+    results = {name: [] for name in ROUTINES}
+    mon.go()
+    while True:
+        pc, _ = mon.wait_prompt()
+        if pc is None:
+            break
+        name = entry.get(pc)
+        if name is None:
+            mon.go()
+            continue
+
+        # ADDR A  X  Y  SP 00 01 NV-BDIZC ...
+        regs = mon.cmd("r").splitlines()[-1].split()
+        sp = int(regs[4], 16)
+        stack = mon.cmd("m $%04x $%04x" % (0x101 + sp, 0x102 + sp)).split()
+        ret = (int(stack[2], 16) << 8 | int(stack[1], 16)) + 1
+
+        for n in checkpoints:
+            mon.cmd("disable %d" % n)
+        mon.cmd("sw reset")
+        mon.cmd("until $%04x" % ret)
+        results[name].append(stopwatch(mon))
+        for n in checkpoints:
+            mon.cmd("enable %d" % n)
+        mon.go()
+
+    vice.wait()
+
+    report = {"program": program, "exit_code": vice.returncode, "routines": {}}
+    for name, counts in results.items():
+        report["routines"][name] = {
+            "calls": len(counts),
+            "min": min(counts) if counts else None,
+            "max": max(counts) if counts else None,
+            "total": sum(counts),
+        }
+    with open(output, "w") as f:
+        json.dump(report, f, indent=2, sort_keys=True)
+        f.write("\n")
+
+    for name in ROUTINES:
+        r = report["routines"][name]
+        print("%-24s calls %4d  min %7s  max %7s" % (name, r["calls"], r["min"], r["max"]))
+
+    if vice.returncode != 0:
+        raise SystemExit("bench run did not finish (exit code %d)" % vice.returncode)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,416 @@
+; Fast loader, the first file on the disk image, see d64.py.
+;
+; LOAD"*",8 and RUN start it. It copies itself up to $c000, out of the way
+; of the game, sends the drive code below to the drive's buffer 2 with M-W
+; and starts it with M-E. The drive code finds the game in the directory
+; and sends it over the serial bus a bit at a time, each bit clocked by the
+; C64 toggling CLK and read off DATA a fixed time later:
+;
+;   DATA low while the drive reads a block, released when it's ready
+;   count   1-254 data bytes follow, 0 the file is done, $ff a read failed
+;   data    count bytes, the two link bytes of the block left out
+;   ack     one more CLK toggle, after which the drive reads the next block
+;
+; Bits go most significant first, DATA released for a 1. The C64 sets the
+; pace, so badlines and interrupts on this side only slow it down, and the
+; drive only has to answer within BIT_DELAY.
+;
+; A drive that doesn't run the code (no M-E, or not a 1541) or a failed
+; read falls back to loading the game with the KERNAL.
+
+    .import __LOADER_LOAD__, __LOADER_RUN__, __LOADER_SIZE__
+    .import __DRIVE_LOAD__, __DRIVE_RUN__, __DRIVE_SIZE__
+
+; Free for programs while BASIC isn't running one
+dst     = $fb   ; Next byte of the game, or of the drive code to send
+count   = $fd   ; Bytes left in the block
+value   = $fe   ; Byte being received
+
+DEVICE  = $ba   ; Device the KERNAL last used, this file's
+
+SETLFS  = $ffba
+SETNAM  = $ffbd
+OPEN    = $ffc0
+CLOSE   = $ffc3
+CHKOUT  = $ffc9
+CLRCHN  = $ffcc
+CHROUT  = $ffd2
+LOAD    = $ffd5
+
+CIA2_PRA = $dd00
+CLK_OUT  = $10
+; DATA in is bit 7, for bit and asl
+
+LFN_COMMAND     = 15
+
+; Cycles from toggling CLK to reading DATA, at 5 a loop. The drive answers
+; within about 40 of its own, counted from send_byte, not measured.
+BIT_DELAY       = 10
+
+; Bytes each M-W carries, 34 at most
+CHUNK           = 32
+
+; Both the plain and the crunched build SYS 2061
+GAME_ENTRY      = $080d
+
+    .segment "LOADADDR"
+    .word   $0801
+
+    .segment "EXEHDR"
+    .word   basic_end
+    .word   10
+    .byte   $9e, "2061", 0
+basic_end:
+    .word   0
+
+    .code
+    .assert __LOADER_SIZE__ <= 256, error, "loader too big to copy"
+    ; The last M-W mustn't end past the buffer, where the count would wrap
+    .assert __DRIVE_SIZE__ <= 256 - CHUNK, error, "drive code too big for its buffer"
+start:
+    ldx #<__LOADER_SIZE__
+copy_loader:
+    lda __LOADER_LOAD__ - 1,x
+    sta __LOADER_RUN__ - 1,x
+    dex
+    bne copy_loader
+    jmp boot
+
+    ; Copied to and run from $c000
+    .segment "LOADER"
+boot:
+    lda DEVICE
+    cmp #8
+    bcs :+
+    lda #8
+    sta DEVICE
+:   lda #0
+    jsr open_command
+
+    ; Drive code, a chunk per M-W
+    lda #<__DRIVE_LOAD__
+    sta dst
+    lda #>__DRIVE_LOAD__
+    sta dst+1
+    lda #<__DRIVE_RUN__
+    sta mw_address
+@chunk:
+    ldx #LFN_COMMAND
+    jsr CHKOUT
+    ldy #0
+@command:
+    lda mw,y
+    jsr CHROUT
+    iny
+    cpy #MW_SIZE
+    bne @command
+    ldy #0
+@byte:
+    lda (dst),y
+    jsr CHROUT
+    iny
+    cpy #CHUNK
+    bne @byte
+    jsr CLRCHN
+    lda dst
+    clc
+    adc #CHUNK
+    sta dst
+    bcc :+
+    inc dst+1
+:   lda mw_address
+    clc
+    adc #CHUNK
+    sta mw_address
+    cmp #<(__DRIVE_RUN__ + __DRIVE_SIZE__)
+    bcc @chunk
+
+    ; Opening the command channel again with M-E as the name starts the code
+    ; as soon as the name is sent, without any more bus traffic after
+    lda #LFN_COMMAND
+    jsr CLOSE
+    lda #ME_SIZE
+    ldx #<me
+    ldy #>me
+    jsr open_command
+
+    jsr wait_busy
+    bcs kernal_load
+    jsr get_count
+    beq kernal_load
+    cmp #$ff
+    beq kernal_load
+    ; The first block starts with where the file goes
+    jsr get_byte
+    sta dst
+    jsr get_byte
+    sta dst+1
+    dec count
+    dec count
+    beq @ack
+@store:
+    jsr get_byte
+    ldy #0
+    sta (dst),y
+    inc dst
+    bne :+
+    inc dst+1
+:   dec count
+    bne @store
+@ack:
+    jsr toggle_clk
+    jsr get_count
+    beq loaded
+    cmp #$ff
+    bne @store
+
+    ; Any drive code is back in DOS by now
+kernal_load:
+    lda #LFN_COMMAND
+    jsr CLOSE
+    lda #GAME_NAME_SIZE
+    ldx #<game_name
+    ldy #>game_name
+    jsr SETNAM
+    lda #1
+    ldx DEVICE
+    ldy #1              ; To the file's own address
+    jsr SETLFS
+    lda #0
+    jsr LOAD
+    bcc run
+    rts
+
+loaded:
+    lda #LFN_COMMAND
+    jsr CLOSE
+run:
+    jmp GAME_ENTRY
+
+; Open the command channel with the A bytes at X/Y as its name
+open_command:
+    jsr SETNAM
+    lda #LFN_COMMAND
+    ldx DEVICE
+    ldy #15
+    jsr SETLFS
+    jmp OPEN
+
+; Carry clear once the drive code has pulled DATA low, set if it never does
+wait_busy:
+    ldx #0
+    ldy #0
+@wait:
+    bit CIA2_PRA
+    bpl @busy
+    dex
+    bne @wait
+    dey
+    bne @wait
+    sec
+    rts
+@busy:
+    clc
+    rts
+
+; Wait for the drive to be ready, then take the block's count
+get_count:
+    bit CIA2_PRA
+    bpl get_count
+    jsr get_byte
+    sta count
+    rts
+
+get_byte:
+    ldx #8
+@bit:
+    jsr toggle_clk
+    lda CIA2_PRA
+    asl
+    rol value
+    dex
+    bne @bit
+    lda value
+    rts
+
+; Give the drive BIT_DELAY cycles to answer
+toggle_clk:
+    lda CIA2_PRA
+    eor #CLK_OUT
+    sta CIA2_PRA
+    ldy #BIT_DELAY
+@delay:
+    dey
+    bne @delay
+    rts
+
+; Drive commands, lower case being PETSCII upper case. mw is followed by
+; CHUNK bytes of drive code.
+mw:
+    .byte   "m-w"
+mw_address:
+    .word   __DRIVE_RUN__
+    .byte   CHUNK
+MW_SIZE = * - mw
+me:
+    .byte   "m-e"
+    .word   drive_start
+ME_SIZE = * - me
+
+game_name:
+    .byte   "shenzhen"          ; Keep in sync with d64.py
+GAME_NAME_SIZE = * - game_name
+
+; Runs in the drive, from buffer 2
+    .segment "DRIVE"
+
+SERIAL          = $1800
+DATA_OUT        = $02
+CLK_IN          = $04
+
+; Job queue entry and buffer for buffer 0
+JOB             = $00
+JOB_TRACK       = $06
+JOB_SECTOR      = $07
+JOB_READ        = $80
+BUFFER          = $0300
+
+DIR_TRACK       = 18
+DIR_SECTOR      = 1
+PRG_FILE        = $82
+NAME_SIZE       = 16
+ENTRY_SIZE      = 32
+
+drive_start:
+    sei
+    lda #DATA_OUT
+    sta SERIAL
+    lda SERIAL
+    and #CLK_IN
+    sta clk
+
+    ldx #DIR_TRACK
+    ldy #DIR_SECTOR
+dir_block:
+    jsr read_block
+    bcs drive_failed
+    ldy #2
+entry:
+    sty entry_at
+    lda BUFFER,y
+    cmp #PRG_FILE
+    bne next_entry
+    ldx #0
+name:
+    lda BUFFER+3,y
+    cmp drive_name,x
+    bne next_entry
+    iny
+    inx
+    cpx #NAME_SIZE
+    bne name
+    ldy entry_at
+    ldx BUFFER+1,y
+    lda BUFFER+2,y
+    tay
+    jmp file_block
+
+next_entry:
+    lda entry_at
+    clc
+    adc #ENTRY_SIZE
+    tay
+    bcc entry
+    ldx BUFFER
+    beq drive_failed
+    ldy BUFFER+1
+    bne dir_block       ; Always, sector 0 is the BAM
+
+file_block:
+    jsr read_block
+    bcs drive_failed
+    ldx #254
+    lda BUFFER
+    bne :+
+    ldx BUFFER+1        ; The last block ends at this byte
+    dex
+:   txa
+    jsr send_count
+    ldy #2
+@data:
+    lda BUFFER,y
+    jsr send_byte
+    iny
+    dex
+    bne @data
+    ; Busy again once the C64 has it all
+    jsr wait_clk
+    lda #DATA_OUT
+    sta SERIAL
+    ldx BUFFER
+    beq drive_done
+    ldy BUFFER+1
+    jmp file_block
+
+drive_done:
+    lda #0
+    .byte   $2c         ; bit abs, skipping the lda #$ff
+drive_failed:
+    lda #$ff
+    jsr send_count
+    lda #0
+    sta SERIAL
+    cli
+    rts
+
+; Read track X sector Y into BUFFER, carry set if that failed
+read_block:
+    stx JOB_TRACK
+    sty JOB_SECTOR
+    lda #JOB_READ
+    sta JOB
+    cli
+@wait:
+    lda JOB
+    bmi @wait
+    sei
+    cmp #2
+    rts
+
+send_count:
+    ldy #0
+    sty SERIAL
+send_byte:
+    sta byte
+    lda #8
+    sta bits
+@bit:
+    jsr wait_clk
+    lda #0
+    asl byte
+    bcs :+
+    lda #DATA_OUT
+:   sta SERIAL
+    dec bits
+    bne @bit
+    rts
+
+wait_clk:
+    lda SERIAL
+    and #CLK_IN
+    cmp clk
+    beq wait_clk
+    sta clk
+    rts
+
+clk:
+    .byte   0
+byte:
+    .byte   0
+bits:
+    .byte   0
+entry_at:
+    .byte   0
+drive_name:
+    .byte   "shenzhen"          ; Keep in sync with d64.py
+    .res    NAME_SIZE - (* - drive_name), $a0
@@ -0,0 +1,96 @@
+; Startup for the cartridge build, see c64-cart.cfg. It takes the place of
+; cc65's crt0, which expects BASIC to have loaded and run the program.
+;
+; The KERNAL finds the cartridge by the CBM80 after the two vectors and
+; jumps to the first one at power on or reset, before any of its own setup.
+; That's done here as the KERNAL would, less the RAM test, which is most
+; of its time and only finds the top of memory the config already knows.
+; Then the C runtime: BSS cleared, DATA copied out of ROM, the C stack set
+; up and the constructors run, which copy CHARMEM (charset.s) and the
+; blitter (card.s).
+;
+; There's no BASIC to go back to when main() returns, after Q or a game
+; won, so exit() resets the machine, and the cartridge starts again on a
+; new deal.
+
+    .export _exit
+    .export __STARTUP__ : absolute = 1
+    .import initlib, donelib, callmain, zerobss, copydata
+    .import __HIMEM__
+    ; sp is the C stack pointer in cc65 2.19, which CC65_HOME points at.
+    ; Later versions rename it c_sp.
+    .include "zeropage.inc"
+
+CINT            = $ff81
+IOINIT          = $ff84
+RESTOR          = $ff8a
+CHROUT          = $ffd2
+; End of the KERNAL's NMI handler, so RESTORE does nothing
+NMI_RETURN      = $febc
+RESET_VECTOR    = $fffc
+
+; What RAMTAS sets up besides the RAM test
+TAPE_BUFFER     = $033c
+TAPE_PTR        = $b2
+MEMBOT          = $0281
+MEMTOP          = $0283
+SCREEN_PAGE     = $0288
+
+    .segment "CARTHDR"
+    .word   cold_start
+    .word   NMI_RETURN
+    .byte   $c3, $c2, $cd, "80"     ; CBM80, CBM in PETSCII with bit 7 set
+
+    .segment "STARTUP"
+cold_start:
+    sei
+    ldx #$ff
+    txs
+    cld
+    jsr IOINIT
+
+    ; RAMTAS: zero page, and pages 2 and 3
+    lda #0
+    tay
+@clear:
+    sta $0002,y
+    sta $0200,y
+    sta $0300,y
+    iny
+    bne @clear
+    lda #<TAPE_BUFFER
+    sta TAPE_PTR
+    lda #>TAPE_BUFFER
+    sta TAPE_PTR+1
+    lda #<$0800
+    sta MEMBOT
+    lda #>$0800
+    sta MEMBOT+1
+    lda #<$8000                     ; The cartridge
+    sta MEMTOP
+    lda #>$8000
+    sta MEMTOP+1
+    lda #>$0400
+    sta SCREEN_PAGE
+
+    jsr RESTOR
+    jsr CINT
+    cli
+
+    ; Lower case, as crt0 does
+    lda #14
+    jsr CHROUT
+
+    jsr zerobss
+    jsr copydata
+    lda #<__HIMEM__
+    sta sp
+    lda #>__HIMEM__
+    sta sp+1
+    jsr initlib
+    jsr callmain
+
+    ; Nothing to go back to, so start over, see above
+_exit:
+    jsr donelib
+    jmp (RESET_VECTOR)
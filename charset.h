@@ -1,6 +1,8 @@
 #ifndef _CHARSET_H_
 #define _CHARSET_H_
 
+#include "images/assets.h"
+
 #define SCREENMEM_SIZE 1000
 struct screen_memory {
     char mem[SCREENMEM_SIZE];
@@ -8,35 +10,46 @@ struct screen_memory {
     char sprite_ptr[8];
 };
 
+#ifdef __CC65__
+/*
+ * Two screen pages in the same VIC bank. Drawing goes to the hidden one,
+ * screen_draw, and its colours to color_shadow, until screen_present()
+ * shows it.
+ */
 extern struct screen_memory SCREENMEM;
+extern struct screen_memory SCREENMEM2;
+extern struct screen_memory *screen_draw;
+/* Which page screen_draw is, 0 or 1 */
+extern uint8_t screen_page;
+extern uint8_t color_shadow[SCREENMEM_SIZE];
 /* Get a pointer to screen ram */
-#define get_screen_mem() (&SCREENMEM)
-/* The offset value that VIC.addr should be set to */
+#define get_screen_mem() (screen_draw)
+/* Get a pointer to where colours are drawn */
+#define get_color_mem() (color_shadow)
+/* Sprites look in the page being shown, so set both */
+#define set_sprite_ptr(sprite, ptr) \
+    (SCREENMEM.sprite_ptr[sprite] = SCREENMEM2.sprite_ptr[sprite] = (ptr))
+/* The offset values that VIC.addr should be set to, for each page */
 extern char SCREENREG;
+extern char SCREENREG2;
+#else
+extern struct screen_memory SCREENMEM;
+/* Get a pointer to screen ram */
+#define get_screen_mem() (&SCREENMEM)
+#define get_color_mem() (COLOR_RAM)
+#endif
 
 extern char CHARMEM[256 * 8];
 
-extern char CARD_TOP_LEFT[8]; /* Acutal address */
-extern char CARD_BOTTOM_RIGHT[8]; /* Acutal address */
-
-/* ASM defines these symbols as character table offsets */
-extern char CARD_IDX_TOP;
-extern char CARD_IDX_TOP_LEFT;
-extern char CARD_IDX_TOP_RIGHT;
-extern char CARD_IDX_BOTTOM;
-extern char CARD_IDX_BOTTOM_LEFT;
-extern char CARD_IDX_BOTTOM_RIGHT;
-extern char CARD_IDX_LEFT;
-extern char CARD_IDX_RIGHT;
-#define CARD_IDX(C) ((char)&CARD_IDX_ ##C)
-#define CARD_IDX_TOP_LEFT(num) (CARD_IDX(TOP_LEFT) + num - 1)
-#define CARD_IDX_BOTTOM_RIGHT(num) (CARD_IDX(BOTTOM_RIGHT) + num - 1)
+/* Character indexes of the card glyphs, from images/assets.py */
+#define CARD_IDX(C) ((char)CARD_IDX_ ##C)
+/* By card_number(), defined in draw.c */
+extern const uint8_t card_top_left[NUM_CARD_GLYPHS];
+extern const uint8_t card_bottom_right[NUM_CARD_GLYPHS];
+#define CARD_IDX_TOP_LEFT(num) (card_top_left[num])
+#define CARD_IDX_BOTTOM_RIGHT(num) (card_bottom_right[num])
 
-extern uint8_t SPRITE_PTR_CARD_TOP;
-extern uint8_t SPRITE_PTR_CARD_BOTTOM;
-extern uint8_t SPRITE_PTR_CARD_BG;
-extern uint8_t SPRITE_PTR_MOUSE;
-extern uint8_t SPRITE_CARD_TOP[63];
-extern uint8_t SPRITE_CARD_BOTTOM[63];
+/* Sprite pointer to a card number's TOPS, BOTTOMS or LABELS frame */
+#define CARD_FRAME(kind, num) ((uint8_t)&SPRITE_PTR_CARD_ ##kind + (num) - 1)
 
 #endif
@@ -1,94 +1,108 @@
+    .include "images/assets.inc"
+
     .segment "CHARMEM"
     .export _CHARMEM
     .align  256 * 8
 
-    .export _SCREENREG = (_SCREENMEM >> (2 + 4)) | (_CHARMEM >> 10) ; Use our char mem
+    ; Offsets within the VIC bank, whichever one the segments are in
+    .export _SCREENREG = ((_SCREENMEM >> (2 + 4)) & $f0) | ((_CHARMEM >> 10) & $0e) ; Use our char mem
+    .export _SCREENREG2 = ((_SCREENMEM2 >> (2 + 4)) & $f0) | ((_CHARMEM >> 10) & $0e) ; Second page, see screen_present()
     ;.export _SCREENREG = ($400 >> (2 + 4)) | (_CHARMEM >> 10) ; Use our char mem with stock screen ram position
     ;.export _SCREENREG = (_SCREENMEM >> (2 + 4)) | ($1000 >> 10) ; Use the ROM
     ;.export _SCREENREG = _CHARMEM >> 10 ; Use our char mem with stock screen ram position
-    .export _SCREENMEM
-_SCREENMEM:
-    .res    1024
-    .align  64
-    .export _SPRITE_PTR_CARD_TOP = _SPRITE_CARD_TOP / 64
-    .export _SPRITE_CARD_TOP
-_SPRITE_CARD_TOP:
-    .incbin "images/cardsprite_top.bitmap"
-    .align  64
-
-    .export _SPRITE_PTR_CARD_BOTTOM = _SPRITE_CARD_BOTTOM / 64
-    .export _SPRITE_CARD_BOTTOM
-_SPRITE_CARD_BOTTOM:
-    .incbin "images/cardsprite_bottom.bitmap"
-    .align  64
-
-.export _SPRITE_PTR_CARD_BG = SPRITE_CARD_BG / 64
-SPRITE_CARD_BG:
-    .incbin "images/cardsprite_bg.bitmap"
-    .align  64
-
-.export _SPRITE_PTR_MOUSE = SPRITE_MOUSE / 64
-SPRITE_MOUSE:
-    .incbin "images/mouse_sprite.bitmap"
-    .align  64
 
-    .align 1024
+    ; ROM characters first, then the card glyphs from images/, see
+    ; images/assets.py
 _CHARMEM:
     .res    33*8 ; 33 chars from the ROM table will be copied here. 33rd is space (blank) character
-    ; Numbers 1-10
-    .export _CARD_IDX_TOP_LEFT = (_CARD_TOP_LEFT - _CHARMEM) / 8
-    .export _CARD_TOP_LEFT
-_CARD_TOP_LEFT:
-    .incbin "images/1.bitmap"
-    .incbin "images/2.bitmap"
-    .incbin "images/3.bitmap"
-    .incbin "images/4.bitmap"
-    .incbin "images/5.bitmap"
-    .incbin "images/6.bitmap"
-    .incbin "images/7.bitmap"
-    .incbin "images/8.bitmap"
-    .incbin "images/9.bitmap" ; Really this is the same a 6 reversed
-    .incbin "images/dragon.bitmap"
-    .incbin "images/flower.bitmap"
-    .incbin "images/blank.bitmap"
-    .export _CARD_IDX_BOTTOM_RIGHT = (_CARD_BOTTOM_RIGHT - _CHARMEM) / 8
-    .export _CARD_BOTTOM_RIGHT
-_CARD_BOTTOM_RIGHT:
-    .incbin "images/1.reversed.bitmap"
-    .incbin "images/2.reversed.bitmap"
-    .incbin "images/3.reversed.bitmap"
-    .incbin "images/4.reversed.bitmap"
-    .incbin "images/5.reversed.bitmap"
-    .incbin "images/6.reversed.bitmap"
-    .incbin "images/7.reversed.bitmap"
-    .incbin "images/8.reversed.bitmap"
-    .incbin "images/9.reversed.bitmap"
-    .incbin "images/dragon.reversed.bitmap"
-    .incbin "images/flower.reversed.bitmap"
-    .incbin "images/blank.reversed.bitmap"
+    ASSET_GLYPHS
+    .assert * - _CHARMEM = ASSET_CHARS_END * 8, error, "glyphs are not where assets.h says"
 
-    .export _CARD_IDX_TOP = (CARD_TOP - _CHARMEM) / 8
-CARD_TOP:
-    .byte   $ff, $00, $00, $00, $00, $00, $00, $00
+    ; Extended background color mode only shows the first 64 characters, so
+    ; the rest of the 2K the VIC fetches the charset from is free for the
+    ; sprites and the card frames from images/. They go last, as only the
+    ; VIC reads them, see c64.cfg.
+    .res    64 * 8 - (* - _CHARMEM)
+    ASSET_SPRITES
 
-    .export _CARD_IDX_RIGHT = (CARD_RIGHT - _CHARMEM) / 8
-CARD_RIGHT:
-    .byte   $01, $01, $01, $01, $01, $01, $01, $01
+    ; Both screen pages, which have to be in the same VIC bank as the
+    ; charset and the sprites. Nothing needs loading into them, so the
+    ; linker configs put them next to CHARMEM without taking up the file.
+    .segment "SCREENS"
+    .align  1024
+    .export _SCREENMEM
+_SCREENMEM:
+    .res    1024
+    .export _SCREENMEM2
+_SCREENMEM2:
+    .res    1024
+
+    ; If BSS ran into either, zerobss would wipe the graphics and drawing
+    ; would overwrite variables
+    .import __CHARMEM_RUN__, __CHARMEM_SIZE__, __SCREENS_RUN__, __SCREENS_SIZE__
+    .import __BSS_RUN__, __BSS_SIZE__
+    .assert __BSS_RUN__ + __BSS_SIZE__ <= __CHARMEM_RUN__ .or __BSS_RUN__ >= __CHARMEM_RUN__ + __CHARMEM_SIZE__, error, "BSS overlaps CHARMEM"
+    .assert __BSS_RUN__ + __BSS_SIZE__ <= __SCREENS_RUN__ .or __BSS_RUN__ >= __SCREENS_RUN__ + __SCREENS_SIZE__, error, "BSS overlaps SCREENS"
 
-    .export _CARD_IDX_BOTTOM = (CARD_BOTTOM - _CHARMEM) / 8
-CARD_BOTTOM:
-    .byte   $00, $00, $00, $00, $00, $00, $00, $ff
+    ; VIC bank the maps run both segments in. Keep in sync with screen.c.
+.ifdef CART
+VIC_BANK        = 1
+.else
+VIC_BANK        = 3
+.endif
+    .assert __CHARMEM_RUN__ >> 14 = VIC_BANK .and (__CHARMEM_RUN__ + __CHARMEM_SIZE__ - 1) >> 14 = VIC_BANK, error, "CHARMEM is not in the VIC bank"
+    .assert __SCREENS_RUN__ >> 14 = VIC_BANK .and (__SCREENS_RUN__ + __SCREENS_SIZE__ - 1) >> 14 = VIC_BANK, error, "SCREENS is not in the VIC bank"
+    ; In banks 0 and 2 the VIC sees the ROM charset at $1000-$1fff instead
+.if VIC_BANK = 0 .or VIC_BANK = 2
+    .assert __CHARMEM_RUN__ & $3fff >= $2000 .or (__CHARMEM_RUN__ + __CHARMEM_SIZE__ - 1) & $3fff < $1000, error, "CHARMEM is under the ROM charset"
+    .assert __SCREENS_RUN__ & $3fff >= $2000 .or (__SCREENS_RUN__ + __SCREENS_SIZE__ - 1) & $3fff < $1000, error, "SCREENS is under the ROM charset"
+.endif
 
-    .export _CARD_IDX_BOTTOM_LEFT = (CARD_BOTTOM_LEFT - _CHARMEM) / 8
-CARD_BOTTOM_LEFT:
-    .byte   $80, $80, $80, $80, $80, $80, $80, $7f
+    ; c64.cfg and c64-cart.cfg load the segment with the program and run it
+    ; in the VIC bank, so copy it there before main() touches any of it
+    .import __CHARMEM_LOAD__
+    .importzp ptr1, ptr2
+    .constructor copy_charmem
+    .segment "CHARMEM"
+    .align  256
+    .assert <__CHARMEM_SIZE__ = 0, error, "CHARMEM is copied whole pages at a time"
 
-    .export _CARD_IDX_TOP_RIGHT = (CARD_TOP_RIGHT - _CHARMEM) / 8
-CARD_TOP_RIGHT:
-    .byte   $fe, $01, $01, $01, $01, $01, $01, $01
+CPU_PORT        = $01
+ALL_RAM         = $34
 
-    .export _CARD_IDX_LEFT = (CARD_LEFT - _CHARMEM) / 8
-CARD_LEFT:
-    .byte   $80, $80, $80, $80, $80, $80, $80, $80
-    ; solid
-    .byte   $ff, $ff, $ff, $ff, $ff, $ff, $ff, $ff
+    .segment "ONCE"
+copy_charmem:
+    lda #<__CHARMEM_LOAD__
+    sta ptr1
+    lda #>__CHARMEM_LOAD__
+    sta ptr1+1
+    lda #<__CHARMEM_RUN__
+    sta ptr2
+    lda #>__CHARMEM_RUN__
+    sta ptr2+1
+.ifndef CART
+    ; In bank 3 the card frames run on under the I/O area, so that's banked
+    ; out while copying, and the KERNAL's vectors with it
+    sei
+    lda CPU_PORT
+    pha
+    lda #ALL_RAM
+    sta CPU_PORT
+.endif
+    ldx #>__CHARMEM_SIZE__
+    ldy #0
+@byte:
+    lda (ptr1),y
+    sta (ptr2),y
+    iny
+    bne @byte
+    inc ptr1+1
+    inc ptr2+1
+    dex
+    bne @byte
+.ifndef CART
+    pla
+    sta CPU_PORT
+    cli
+.endif
+    rts
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+#
+# Wraps the cartridge build's ROM, linked by c64-cart.cfg, in a CRT file
+# for VICE (x64sc -cartcrt): a normal cartridge, 8K at $8000 or 16K at
+# $8000-$bfff by the size of the ROM, in one CHIP packet.
+#
+# Usage: crt.py CRT ROM
+
+import struct
+import sys
+
+# Keep in sync with c64-cart.cfg and cart.s
+LOAD_AT = 0x8000
+CBM80 = bytes([0xc3, 0xc2, 0xcd, 0x38, 0x30])
+
+NAME = "SHENZHEN I/O"
+
+HEADER_SIZE = 0x40
+VERSION = 0x0100
+NORMAL_CARTRIDGE = 0
+CHIP_HEADER_SIZE = 0x10
+CHIP_ROM = 0
+
+# EXROM and GAME as the cartridge drives them, 0 being low
+LINES = {
+    0x2000: (0, 1),
+    0x4000: (0, 0),
+}
+
+
+def fail(msg):
+    sys.exit("crt.py: " + msg)
+
+
+def main():
+    if len(sys.argv) != 3:
+        fail("usage: crt.py CRT ROM")
+    crt_path, rom_path = sys.argv[1:]
+
+    with open(rom_path, "rb") as f:
+        rom = f.read()
+    if len(rom) not in LINES:
+        fail("%s: %d bytes, not 8K or 16K" % (rom_path, len(rom)))
+    if rom[4:9] != CBM80:
+        fail("%s: no CBM80 after the start vectors" % rom_path)
+    exrom, game = LINES[len(rom)]
+
+    header = struct.pack(">16sIHHBB6x32s", b"C64 CARTRIDGE   ", HEADER_SIZE,
+                         VERSION, NORMAL_CARTRIDGE, exrom, game,
+                         NAME.encode("ascii"))
+    chip = struct.pack(">4sIHHHH", b"CHIP", CHIP_HEADER_SIZE + len(rom),
+                       CHIP_ROM, 0, LOAD_AT, len(rom))
+    with open(crt_path, "wb") as f:
+        f.write(header + chip + rom)
+
+
+if __name__ == "__main__":
+    main()
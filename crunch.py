@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+#
+# Packs the linked PRG for the self-decrunching build, see decrunch.s.
+#
+# The stream is a list of tokens, byte aligned so the 6502 side stays small
+# and quick:
+#
+#   $00-$7f  n    literal run, the next n + 1 bytes are copied as they are
+#   $80-$fe  n    match, copy (n & $7f) + MIN_MATCH bytes from the output
+#                 the next two bytes (low first) back
+#   $ff           end
+#
+# Writes the packed stream, and an include for decrunch.s with where the
+# image goes, where it starts and how big the stream is.
+#
+# Usage: crunch.py PROGRAM PACKED INCLUDE
+
+import sys
+
+MIN_MATCH = 3
+MAX_MATCH = 0x7e + MIN_MATCH
+MAX_LITERALS = 0x80
+MAX_OFFSET = 0xffff
+END = 0xff
+
+# How many earlier places with the same first bytes to try
+MAX_CANDIDATES = 256
+
+BASIC_SYS = 0x9e
+
+
+def fail(msg):
+    sys.exit("crunch.py: " + msg)
+
+
+def sys_address(load, image):
+    """The address the image's BASIC line SYSes to"""
+    if load != 0x0801:
+        fail("not a BASIC program: loads at $%04x" % load)
+    line_end = image.index(0, 4)
+    line = image[4:line_end]
+    if BASIC_SYS not in line:
+        fail("no SYS in the BASIC line")
+    digits = bytes(line[line.index(BASIC_SYS) + 1:]).strip()
+    return int(digits.decode("ascii"))
+
+
+def crunch(data):
+    out = bytearray()
+    literals = bytearray()
+    # Earlier positions by their first MIN_MATCH bytes
+    seen = {}
+
+    def flush():
+        while literals:
+            run = literals[:MAX_LITERALS]
+            del literals[:MAX_LITERALS]
+            out.append(len(run) - 1)
+            out.extend(run)
+
+    def longest(i):
+        best_len = 0
+        best_off = 0
+        for j in reversed(seen.get(data[i:i + MIN_MATCH], ())):
+            if i - j > MAX_OFFSET:
+                break
+            n = 0
+            limit = min(MAX_MATCH, len(data) - i)
+            while n < limit and data[j + n] == data[i + n]:
+                n += 1
+            if n > best_len:
+                best_len, best_off = n, i - j
+                if n == limit:
+                    break
+        return best_len, best_off
+
+    def remember(i):
+        key = data[i:i + MIN_MATCH]
+        if len(key) == MIN_MATCH:
+            where = seen.setdefault(key, [])
+            where.append(i)
+            if len(where) > MAX_CANDIDATES:
+                del where[0]
+
+    i = 0
+    while i < len(data):
+        length, offset = longest(i)
+        # Lazy: a literal now is worth it if the next match is longer
+        if length >= MIN_MATCH and i + 1 < len(data):
+            remember(i)
+            next_length, _ = longest(i + 1)
+            if next_length > length + 1:
+                literals.append(data[i])
+                i += 1
+                continue
+        else:
+            remember(i)
+        if length < MIN_MATCH:
+            literals.append(data[i])
+            i += 1
+            continue
+        flush()
+        out.append(0x80 | (length - MIN_MATCH))
+        out.append(offset & 0xff)
+        out.append(offset >> 8)
+        for k in range(i + 1, i + length):
+            remember(k)
+        i += length
+    flush()
+    out.append(END)
+    return bytes(out)
+
+
+def decrunch(packed):
+    """What decrunch.s does, to check the stream"""
+    out = bytearray()
+    i = 0
+    while packed[i] != END:
+        token = packed[i]
+        i += 1
+        if token < 0x80:
+            out += packed[i:i + token + 1]
+            i += token + 1
+        else:
+            offset = packed[i] | packed[i + 1] << 8
+            i += 2
+            for _ in range((token & 0x7f) + MIN_MATCH):
+                out.append(out[-offset])
+    return bytes(out)
+
+
+def main():
+    if len(sys.argv) != 4:
+        fail("usage: crunch.py PROGRAM PACKED INCLUDE")
+    program, packed_path, include_path = sys.argv[1:]
+
+    with open(program, "rb") as f:
+        prg = f.read()
+    load = prg[0] | prg[1] << 8
+    image = prg[2:]
+    entry = sys_address(load, image)
+
+    packed = crunch(image)
+    if decrunch(packed) != image:
+        fail("packed stream does not unpack to the image")
+
+    with open(packed_path, "wb") as f:
+        f.write(packed)
+    with open(include_path, "w") as f:
+        f.write("; Generated by crunch.py from %s, do not edit\n" % program)
+        f.write("UNPACKED_START = $%04x\n" % load)
+        f.write("UNPACKED_END = $%04x\n" % (load + len(image)))
+        f.write("ENTRY = $%04x\n" % entry)
+        f.write("PACKED_SIZE = %d\n" % len(packed))
+        f.write("MIN_MATCH = %d\n" % MIN_MATCH)
+
+    print("%s: %d bytes packed to %d (%d%%)" %
+          (program, len(image), len(packed), 100 * len(packed) // len(image)))
+
+
+if __name__ == "__main__":
+    main()
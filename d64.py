@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+#
+# Builds the 1541 disk image: the fast loader first, so LOAD"*",8 finds it,
+# then the game it loads, then the block the game saves to.
+#
+#   BOOT        PRG  boot.s, loaded by the KERNAL
+#   SHENZHEN    PRG  the game, loaded by boot.s's drive code
+#   SAVE        USR  one block, written in place by disk.c
+#
+# The game's blocks are spread out for the fast loader rather than the
+# KERNAL: each is sent before the next is read, so the next one to use is
+# the first that comes round after that.
+#
+# Usage: d64.py IMAGE BOOT GAME
+
+import math
+import sys
+
+TRACKS = 35
+BLOCK_SIZE = 256
+DATA_SIZE = BLOCK_SIZE - 2
+
+DIR_TRACK = 18
+BAM_SECTOR = 0
+DIR_SECTOR = 1
+
+# Keep in sync with disk.c
+SAVE_TRACK = 19
+SAVE_SECTOR = 0
+
+# Keep in sync with boot.s
+BOOT_NAME = "BOOT"
+GAME_NAME = "SHENZHEN"
+SAVE_NAME = "SAVE"
+# Where boot.s runs from, which the game mustn't load over
+LOADER_AT = 0xc000
+
+DISK_NAME = "SHENZHEN I/O"
+DISK_ID = "SZ"
+
+PRG = 0x82
+USR = 0x83
+PAD = 0xa0
+
+ROTATION_MS = 200
+# Time for boot.s to take a block, from its bit timing, not measured
+TRANSFER_MS = 170
+# Block sent by the KERNAL, the usual interleave
+KERNAL_INTERLEAVE = 10
+
+
+def fail(msg):
+    sys.exit("d64.py: " + msg)
+
+
+def sectors(track):
+    if track <= 17:
+        return 21
+    if track <= 24:
+        return 19
+    if track <= 30:
+        return 18
+    return 17
+
+
+def fast_interleave(track):
+    """Sectors that go by while boot.s takes a block, and one more"""
+    return math.ceil(TRANSFER_MS / (ROTATION_MS / sectors(track))) + 1
+
+
+def petscii(name, size=16):
+    if len(name) > size:
+        fail("%s: name too long" % name)
+    return name.encode("ascii") + bytes([PAD] * (size - len(name)))
+
+
+class Disk:
+    def __init__(self):
+        self.blocks = {(t, s): bytearray(BLOCK_SIZE)
+                       for t in range(1, TRACKS + 1) for s in range(sectors(t))}
+        self.used = set()
+        self.entries = []
+        for block in ((DIR_TRACK, BAM_SECTOR), (DIR_TRACK, DIR_SECTOR),
+                      (SAVE_TRACK, SAVE_SECTOR)):
+            self.used.add(block)
+
+    def tracks(self):
+        """Nearest the directory first, so the head moves least"""
+        for track in range(DIR_TRACK - 1, 0, -1):
+            yield track
+        for track in range(DIR_TRACK + 1, TRACKS + 1):
+            yield track
+
+    def allocate(self, count, interleave):
+        chain = []
+        tracks = self.tracks()
+        track = next(tracks)
+        sector = 0
+        while len(chain) < count:
+            n = sectors(track)
+            for i in range(n):
+                candidate = (track, (sector + i) % n)
+                if candidate not in self.used:
+                    break
+            else:
+                try:
+                    track = next(tracks)
+                except StopIteration:
+                    fail("disk full")
+                sector = 0
+                continue
+            self.used.add(candidate)
+            chain.append(candidate)
+            sector = (candidate[1] + interleave(track)) % n
+        return chain
+
+    def add_file(self, name, kind, data, interleave, first=False):
+        count = max(1, math.ceil(len(data) / DATA_SIZE))
+        chain = self.allocate(count, interleave)
+        self.write_chain(chain, data)
+        self.entries.insert(0 if first else len(self.entries),
+                            (name, kind, chain[0], count))
+
+    def write_chain(self, chain, data):
+        for i, block in enumerate(chain):
+            part = data[i * DATA_SIZE:(i + 1) * DATA_SIZE]
+            b = self.blocks[block]
+            if i + 1 < len(chain):
+                b[0:2] = bytes(chain[i + 1])
+            else:
+                # No next block, and the offset of the last byte used
+                b[0:2] = bytes([0, len(part) + 1])
+            b[2:2 + len(part)] = part
+
+    def add_save(self):
+        block = (SAVE_TRACK, SAVE_SECTOR)
+        # Empty until the game saves to it
+        self.write_chain([block], b"")
+        self.entries.append((SAVE_NAME, USR, block, 1))
+
+    def write_directory(self):
+        if len(self.entries) > 8:
+            fail("too many files for one directory block")
+        d = self.blocks[(DIR_TRACK, DIR_SECTOR)]
+        d[0:2] = bytes([0, 0xff])
+        for i, (name, kind, (track, sector), count) in enumerate(self.entries):
+            e = 32 * i
+            d[e + 2] = kind
+            d[e + 3] = track
+            d[e + 4] = sector
+            d[e + 5:e + 21] = petscii(name)
+            d[e + 30] = count & 0xff
+            d[e + 31] = count >> 8
+
+    def write_bam(self):
+        b = self.blocks[(DIR_TRACK, BAM_SECTOR)]
+        b[0:4] = bytes([DIR_TRACK, DIR_SECTOR, 0x41, 0])
+        for track in range(1, TRACKS + 1):
+            free = [s for s in range(sectors(track)) if (track, s) not in self.used]
+            bits = sum(1 << s for s in free)
+            e = 4 * track
+            b[e] = len(free)
+            b[e + 1:e + 4] = bits.to_bytes(3, "little")
+        b[0x90:0xa0] = petscii(DISK_NAME)
+        b[0xa0:0xa2] = bytes([PAD, PAD])
+        b[0xa2:0xa4] = DISK_ID.encode("ascii")
+        b[0xa4] = PAD
+        b[0xa5:0xa7] = b"2A"
+        b[0xa7:0xab] = bytes([PAD] * 4)
+
+    def image(self):
+        self.write_directory()
+        self.write_bam()
+        return b"".join(bytes(self.blocks[(t, s)])
+                        for t in range(1, TRACKS + 1) for s in range(sectors(t)))
+
+
+def read_prg(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < 2:
+        fail("%s: not a program" % path)
+    return data
+
+
+def main():
+    if len(sys.argv) != 4:
+        fail("usage: d64.py IMAGE BOOT GAME")
+    image_path, boot_path, game_path = sys.argv[1:]
+
+    boot = read_prg(boot_path)
+    game = read_prg(game_path)
+    end = (game[0] | game[1] << 8) + len(game) - 2
+    if end > LOADER_AT:
+        fail("%s: loads up to $%04x, over the loader at $%04x" %
+             (game_path, end, LOADER_AT))
+
+    disk = Disk()
+    # The game gets the blocks nearest the directory, the loader what's left
+    disk.add_file(GAME_NAME, PRG, game, fast_interleave)
+    disk.add_file(BOOT_NAME, PRG, boot, lambda track: KERNAL_INTERLEAVE, first=True)
+    disk.add_save()
+
+    with open(image_path, "wb") as f:
+        f.write(disk.image())
+
+
+if __name__ == "__main__":
+    main()
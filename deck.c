@@ -0,0 +1,86 @@
+#include <stdint.h>
+
+#include "game.h"
+#include "deck.h"
+
+/*
+ * 16-bit Galois LFSR (x^16 + x^14 + x^13 + x^11 + 1), maximal length so
+ * every non-zero seed gives its own sequence. Eight steps per byte so that
+ * consecutive draws don't just share shifted bits.
+ */
+static uint16_t lfsr;
+
+static uint8_t lfsr_byte(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < 8; i++) {
+        if (lfsr & 1)
+            lfsr = (lfsr >> 1) ^ 0xb400;
+        else
+            lfsr >>= 1;
+    }
+    return (uint8_t)lfsr;
+}
+
+void deck_cards(card_t *deck)
+{
+    uint8_t i;
+    uint8_t j = 0;
+
+    for (i=0; i<11; i++) {
+        deck[j++] = make_card(i+1, RED);
+    }
+    for (i=0; i<11; i++) {
+        deck[j++] = make_card(i+1, GREEN);
+    }
+    /* No black flower */
+    for (i=0; i<10; i++) {
+        deck[j++] = make_card(i+1, BLACK);
+    }
+
+    /* There are actually 3 each of the dragons, so throw in the extras */
+    deck[j++] = make_card(CARD_DRAGON, RED);
+    deck[j++] = make_card(CARD_DRAGON, RED);
+    deck[j++] = make_card(CARD_DRAGON, GREEN);
+    deck[j++] = make_card(CARD_DRAGON, GREEN);
+    deck[j++] = make_card(CARD_DRAGON, BLACK);
+    deck[j++] = make_card(CARD_DRAGON, BLACK);
+}
+
+void make_deck(card_t *deck, uint16_t seed)
+{
+    uint8_t i;
+    uint8_t mask;
+    uint8_t pick;
+    card_t tmp;
+
+    deck_cards(deck);
+
+    /*
+     * The LFSR has a single cycle, so every seed starts the same sequence
+     * somewhere. Spread the seeds out along it, or seed 2 would deal almost
+     * what seed 1 does one step later.
+     */
+    lfsr = seed * 0x9e37;
+    if (!lfsr)
+        lfsr = 1;
+
+    /*
+     * Fisher-Yates. Instead of a modulo (a division on the 6502), mask the
+     * random byte down to the next power of two and draw again if it's out
+     * of range, which keeps every position equally likely.
+     */
+    mask = 0x3f;
+    for (i = DECK_SIZE-1; i > 0; i--) {
+        while ((mask >> 1) >= i)
+            mask >>= 1;
+        do {
+            pick = lfsr_byte() & mask;
+        } while (pick > i);
+
+        tmp = deck[i];
+        deck[i] = deck[pick];
+        deck[pick] = tmp;
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef _DECK_H_
+#define _DECK_H_
+
+#include <stdint.h>
+
+#include "game.h"
+
+/* Fill deck with the DECK_SIZE cards of a game, in order */
+void deck_cards(card_t *deck);
+
+/*
+ * Fill deck with the DECK_SIZE cards of a game, shuffled by seed. The same
+ * seed always gives the same deck. cards() deals deck[j] onto stack
+ * j % NUM_STACKS, row j / NUM_STACKS.
+ */
+void make_deck(card_t *deck, uint16_t seed);
+
+#endif
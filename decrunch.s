@@ -0,0 +1,171 @@
+; Loader for the self-decrunching build, see crunch.py for the stream.
+;
+; BASIC runs it like the plain build, with SYS 2061. It copies the decoder
+; to the cassette buffer and moves the packed image up to end at $d000,
+; then the decoder unpacks the image over all of that, back to $0801 where
+; ld65 linked it (code, data, CHARMEM and the sprites), and jumps to the
+; image's own SYS address.
+
+    .include "crunched.inc"
+
+    .import __DECODER_LOAD__, __DECODER_RUN__, __DECODER_SIZE__
+    .import __PACKED_LOAD__
+
+; Free for programs while BASIC isn't running one
+src     = $f7   ; Next byte of the packed stream
+dst     = $f9   ; Next byte of the image
+ref     = $fb   ; Where a match copies from
+from    = $fd   ; Only used moving the packed image
+
+CPU_PORT        = $01
+ALL_RAM_IO      = $36   ; BASIC ROM out, so $a000-$bfff reads RAM
+DEFAULT_BANKS   = $37
+
+PACKED_TOP      = $d000
+PACKED_HIGH     = PACKED_TOP - PACKED_SIZE
+
+    ; The decoder only reads bytes it hasn't overwritten if the whole image
+    ; ends below the packed one
+    .assert UNPACKED_END <= PACKED_HIGH, error, "image too big to unpack in place"
+
+    .segment "LOADADDR"
+    .word   $0801
+
+    .segment "EXEHDR"
+    .word   basic_end
+    .word   10
+    .byte   $9e, "2061", 0
+basic_end:
+    .word   0
+
+    .code
+start:
+    lda #ALL_RAM_IO
+    sta CPU_PORT
+
+    ldx #<__DECODER_SIZE__
+copy_decoder:
+    lda __DECODER_LOAD__ - 1,x
+    sta __DECODER_RUN__ - 1,x
+    dex
+    bne copy_decoder
+
+    ; Move the packed image up, last byte first as the two overlap. The
+    ; partial page at the end goes first, then whole pages down.
+    lda #<(__PACKED_LOAD__ + (PACKED_SIZE & $ff00))
+    sta from
+    lda #>(__PACKED_LOAD__ + (PACKED_SIZE & $ff00))
+    sta from+1
+    lda #<(PACKED_HIGH + (PACKED_SIZE & $ff00))
+    sta dst
+    lda #>(PACKED_HIGH + (PACKED_SIZE & $ff00))
+    sta dst+1
+    ldy #<PACKED_SIZE
+    beq @pages
+@tail:
+    dey
+    lda (from),y
+    sta (dst),y
+    tya
+    bne @tail
+@pages:
+    ldx #>PACKED_SIZE
+    beq @moved
+@page:
+    dec from+1
+    dec dst+1
+@byte:
+    dey                 ; Y is 0, so this does 255 down to 0
+    lda (from),y
+    sta (dst),y
+    tya
+    bne @byte
+    dex
+    bne @page
+@moved:
+    jmp decode
+
+    ; Copied to and run from the cassette buffer
+    .segment "DECODER"
+decode:
+    lda #<PACKED_HIGH
+    sta src
+    lda #>PACKED_HIGH
+    sta src+1
+    lda #<UNPACKED_START
+    sta dst
+    lda #>UNPACKED_START
+    sta dst+1
+
+next:
+    ldy #0
+    lda (src),y
+    inc src
+    bne :+
+    inc src+1
+:   cmp #$80
+    bcs match
+
+    ; Literal run of A + 1 bytes, at most 128 so X goes negative after
+    tax
+literal:
+    lda (src),y
+    sta (dst),y
+    iny
+    dex
+    bpl literal
+    tya
+    clc
+    adc src
+    sta src
+    bcc advance
+    inc src+1
+    bcs advance         ; Always
+
+match:
+    cmp #$ff
+    beq done
+    and #$7f
+    clc
+    adc #MIN_MATCH
+    tax
+    ; ref = dst - offset
+    sec
+    lda dst
+    sbc (src),y
+    sta ref
+    iny
+    lda dst+1
+    sbc (src),y
+    sta ref+1
+    lda src
+    clc
+    adc #2
+    sta src
+    bcc :+
+    inc src+1
+:   ldy #0
+copy:
+    lda (ref),y         ; May be a byte this copy just wrote
+    sta (dst),y
+    iny
+    dex
+    bne copy
+
+    ; Y bytes were written
+advance:
+    tya
+    clc
+    adc dst
+    sta dst
+    bcc next
+    inc dst+1
+    jmp next
+
+done:
+    lda #DEFAULT_BANKS
+    sta CPU_PORT
+    jmp ENTRY
+
+    .segment "PACKED"
+    .incbin "crunched.bin"
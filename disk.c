@@ -0,0 +1,90 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <cbm.h>
+
+#include "disk.h"
+
+/* Logical files for the command channel and the block buffer */
+#define LFN_COMMAND     15
+#define LFN_BUFFER      2
+/* The buffer's secondary address, which the block commands name it by */
+#define BUFFER_SA       2
+#define BUFFER          "2"
+
+/* Track and sector of the save block. Keep in sync with d64.py */
+#define SAVE_BLOCK      "19 0"
+
+/*
+ * Block commands. cc65 turns lower case into PETSCII upper case, which is
+ * what the drive expects.
+ */
+#define BLOCK_POINTER   "b-p " BUFFER
+#define BLOCK_READ      "u1 " BUFFER " 0 " SAVE_BLOCK
+#define BLOCK_WRITE     "u2 " BUFFER " 0 " SAVE_BLOCK
+
+/* Whether the drive's last command went through */
+static bool status_ok(void)
+{
+    static char status[40];
+
+    return cbm_read(LFN_COMMAND, status, sizeof(status)) >= 2 &&
+           status[0] == '0' && status[1] == '0';
+}
+
+static bool command(const char *cmd)
+{
+    return cbm_write(LFN_COMMAND, cmd, strlen(cmd)) >= 0 && status_ok();
+}
+
+static bool disk_open(void)
+{
+    uint8_t device = getcurrentdevice();
+
+    if (device < 8)
+        device = 8;
+    if (cbm_open(LFN_COMMAND, device, 15, ""))
+        return false;
+    if (cbm_open(LFN_BUFFER, device, BUFFER_SA, "#")) {
+        cbm_close(LFN_COMMAND);
+        return false;
+    }
+    return true;
+}
+
+static void disk_close(void)
+{
+    cbm_close(LFN_BUFFER);
+    cbm_close(LFN_COMMAND);
+}
+
+bool disk_save(const uint8_t *data, uint8_t len)
+{
+    /* The block is a whole file: no next block, and where its data ends */
+    uint8_t link[2];
+    bool ok;
+
+    if (!disk_open())
+        return false;
+    link[0] = 0;
+    link[1] = len + 1;
+    ok = command(BLOCK_POINTER " 0") &&
+         cbm_write(LFN_BUFFER, link, sizeof(link)) == sizeof(link) &&
+         cbm_write(LFN_BUFFER, data, len) == len &&
+         command(BLOCK_WRITE);
+    disk_close();
+    return ok;
+}
+
+uint8_t disk_restore(uint8_t *data, uint8_t max)
+{
+    int len = 0;
+
+    if (!disk_open())
+        return 0;
+    if (command(BLOCK_READ) && command(BLOCK_POINTER " 2"))
+        len = cbm_read(LFN_BUFFER, data, max);
+    disk_close();
+    return len < 0 ? 0 : len;
+}
@@ -0,0 +1,20 @@
+#ifndef _DISK_H_
+#define _DISK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Saved game storage on the disk the game was loaded from. A save goes
+ * straight into one block that d64.py sets aside, with the drive's block
+ * commands, so there's no file to open, scratch or write a directory entry
+ * for, and only save_game()'s few dozen bytes cross the serial bus.
+ */
+
+/* Write len bytes of data to the save block */
+bool disk_save(const uint8_t *data, uint8_t len);
+
+/* Read up to max bytes of the save block into data, returning how many */
+uint8_t disk_restore(uint8_t *data, uint8_t max);
+
+#endif
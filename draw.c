@@ -0,0 +1,271 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "game.h"
+#include "screen.h"
+#include "charset.h"
+#include "draw.h"
+#include "prof.h"
+
+#ifdef __CC65__
+#define USE_ASM 1
+#else
+#define USE_ASM 0
+#endif
+/* Paint whole cards and stacks with the unrolled blitter in card.s */
+#define USE_SPEEDCODE (USE_ASM && 1)
+
+/* Pointer into screen memory where card drawing is taking place (avoids parameter passing) */
+uint8_t *card_draw_screenpos;
+/* Same as above for color ram */
+uint8_t *card_draw_colorpos;
+
+/* Corner characters of each card number, also used by card.s */
+const uint8_t card_top_left[NUM_CARD_GLYPHS] = CARD_GLYPHS_TOP_LEFT;
+const uint8_t card_bottom_right[NUM_CARD_GLYPHS] = CARD_GLYPHS_BOTTOM_RIGHT;
+
+/* Fill one row of a card's color memory */
+#if !USE_ASM
+static void fastcall set_card_row_color(uint8_t color)
+{
+    memset(card_draw_colorpos, color, CARD_WIDTH);
+}
+#else
+extern void fastcall asm_set_card_row_color(uint8_t color);
+#define set_card_row_color(color) asm_set_card_row_color(color)
+#endif
+
+static void card_draw_line_advance(void)
+{
+    card_draw_screenpos += SCREEN_WIDTH;
+    card_draw_colorpos += SCREEN_WIDTH;
+}
+
+/* Start of each screen row, so positioning a card doesn't need a multiply */
+#define ROW(y) ((y) * SCREEN_WIDTH)
+static const uint16_t row_offset[SCREEN_HEIGHT] = {
+    ROW(0),  ROW(1),  ROW(2),  ROW(3),  ROW(4),
+    ROW(5),  ROW(6),  ROW(7),  ROW(8),  ROW(9),
+    ROW(10), ROW(11), ROW(12), ROW(13), ROW(14),
+    ROW(15), ROW(16), ROW(17), ROW(18), ROW(19),
+    ROW(20), ROW(21), ROW(22), ROW(23), ROW(24),
+};
+#undef ROW
+
+#define card_draw_set_offset(x, y) { \
+    uint16_t offset = (x) + row_offset[y]; \
+    card_draw_screenpos = &get_screen_mem()->mem[offset]; \
+    card_draw_colorpos = &get_color_mem()[offset]; \
+}
+
+#if !USE_ASM
+static void draw_card_top(card_t card)
+{
+    card_draw_screenpos[0] = CARD_IDX_TOP_LEFT(card_number(card));
+    card_draw_screenpos[1] = CARD_IDX(TOP);
+    card_draw_screenpos[2] = CARD_IDX(TOP);
+    card_draw_screenpos[3] = CARD_IDX(TOP_RIGHT);
+}
+#else
+extern void fastcall asm_draw_card_top(card_t card);
+#define draw_card_top(card) asm_draw_card_top(card)
+#endif
+
+/* Draw the left, two middle spaces, and right */
+#if !USE_ASM
+static void draw_card_middle(void)
+{
+    card_draw_screenpos[0] = CARD_IDX(LEFT);
+    card_draw_screenpos[1] = ' ';
+    card_draw_screenpos[2] = ' ';
+    card_draw_screenpos[3] = CARD_IDX(RIGHT);
+}
+#else
+extern void fastcall asm_draw_card_middle(void);
+#define draw_card_middle() asm_draw_card_middle()
+#endif
+
+#if !USE_ASM
+static void draw_card_bottom(card_t card)
+{
+    card_draw_screenpos[0] = CARD_IDX(BOTTOM_LEFT);
+    card_draw_screenpos[1] = CARD_IDX(BOTTOM);
+    card_draw_screenpos[2] = CARD_IDX(BOTTOM);
+    card_draw_screenpos[3] = CARD_IDX_BOTTOM_RIGHT(card_number(card));
+}
+#else
+extern void fastcall asm_draw_card_bottom(card_t card);
+#define draw_card_bottom(card) asm_draw_card_bottom(card)
+#endif
+
+static void draw_bg()
+{
+    card_draw_screenpos[0] = BG_CHAR;
+    card_draw_screenpos[1] = BG_CHAR;
+    card_draw_screenpos[2] = BG_CHAR;
+    card_draw_screenpos[3] = BG_CHAR;
+}
+
+#if USE_SPEEDCODE
+/* Inputs to asm_blit_rows() (avoids parameter passing) */
+const card_t *blit_cards;   /* Cards of the stack, bottom first */
+uint8_t blit_height;        /* Number of cards in blit_cards */
+uint8_t blit_x;             /* Screen column of the stack */
+uint8_t blit_base;          /* Screen row of the first card */
+uint8_t blit_first;         /* First row to paint, relative to blit_base */
+uint8_t blit_last;          /* Last row to paint, relative to blit_base */
+extern void asm_blit_rows(void);
+
+static void draw_card(uint8_t x, uint8_t y, card_t card)
+{
+    static card_t blit_card;
+
+    blit_card = card;
+    blit_cards = &blit_card;
+    blit_height = card ? 1 : 0;
+    blit_x = x;
+    blit_base = y;
+    blit_first = 0;
+    blit_last = CARD_HEIGHT - 1;
+    asm_blit_rows();
+}
+#else
+static void draw_card(uint8_t x, uint8_t y, card_t card)
+{
+    int i;
+
+    card_draw_set_offset(x, y);
+
+    if (card == 0) {
+        for (i = 0; i < CARD_HEIGHT; i++) {
+            set_card_row_color(COLOR_GREEN);
+            draw_bg();
+            card_draw_line_advance();
+        }
+        return;
+    }
+
+    draw_card_top(card);
+    set_card_row_color(card_color(card));
+    card_draw_line_advance();
+
+
+    for (i = 0; i < CARD_HEIGHT - 2; i++) {
+        draw_card_middle();
+        set_card_row_color(card_color(card));
+        card_draw_line_advance();
+    }
+
+    draw_card_bottom(card);
+    set_card_row_color(card_color(card));
+}
+#endif
+
+void draw_done(uint8_t done)
+{
+    draw_done_card(done, done_stack[done]);
+}
+
+void draw_done_card(uint8_t done, uint8_t card)
+{
+    uint8_t x = (done+4) * (CARD_WIDTH+1);
+    screen_mark(done + 4, 1, CARD_HEIGHT);
+    draw_card(x, 1, card);
+}
+
+void draw_cell(uint8_t cell)
+{
+    uint8_t x = cell * (CARD_WIDTH+1);
+    screen_mark(cell, 1, CARD_HEIGHT);
+    draw_card(x, 1, freecells[cell]);
+}
+
+/* Between the free cells and the done piles */
+#define SEED_SLOT   3
+#define SEED_X  (SEED_SLOT * (CARD_WIDTH + 1))
+#define SEED_Y  3
+#define SEED_DIGITS 4
+/* Screen codes of the ROM letters A-Z and the space copied into CHARMEM */
+#define SEED_CHAR(digit)    (char_offset(65) + (digit))
+#define SEED_BLANK          char_offset(96)
+
+void draw_seed(uint16_t seed, uint8_t digits)
+{
+    uint8_t i;
+
+    screen_mark(SEED_SLOT, SEED_Y, SEED_Y);
+    card_draw_set_offset(SEED_X, SEED_Y);
+    for (i = 0; i < SEED_DIGITS; i++) {
+        if (i < digits)
+            card_draw_screenpos[i] = SEED_CHAR((seed >> 12) & 0xf);
+        else
+            card_draw_screenpos[i] = SEED_BLANK;
+        card_draw_colorpos[i] = COLOR_BLACK;
+        seed <<= 4;
+    }
+}
+
+void draw_stack(uint8_t stack)
+{
+    register uint8_t row;
+    register card_t *stack_cards;
+    register uint8_t height;
+    uint8_t last;
+#if !USE_SPEEDCODE
+    register card_t top;
+    uint8_t bottom_row;
+#endif
+
+    if (stack >= NUM_STACKS) {
+        draw_cell(stack - NUM_STACKS);
+        return;
+    }
+
+    row = stack_dirty_first[stack];
+    if (row == STACK_CLEAN)
+        return;
+    last = stack_dirty_last[stack];
+    stack_dirty_first[stack] = STACK_CLEAN;
+    stack_dirty_last[stack] = 0;
+    PROF_ENTER(PROF_DRAW_STACK);
+
+    stack_cards = stacks[stack];
+    height = stack_height[stack];
+    screen_mark(stack, LOWER_STACKS_Y + row, LOWER_STACKS_Y + last);
+
+#if USE_SPEEDCODE
+    blit_cards = stack_cards;
+    blit_height = height;
+    blit_x = stack * (CARD_WIDTH + 1);
+    blit_base = LOWER_STACKS_Y;
+    blit_first = row;
+    blit_last = last;
+    asm_blit_rows();
+#else
+    /* Only the top card shows its body; the rest show just their top row */
+    top = stack_top[stack];
+    bottom_row = height + CARD_HEIGHT - 2;
+
+    card_draw_set_offset(stack * (CARD_WIDTH + 1), LOWER_STACKS_Y + row);
+
+    for (; row <= last; row++) {
+        if (row < height) {
+            draw_card_top(stack_cards[row]);
+            set_card_row_color(card_color(stack_cards[row]));
+        } else if (top && row < bottom_row) {
+            draw_card_middle();
+            set_card_row_color(card_color(top));
+        } else if (top && row == bottom_row) {
+            draw_card_bottom(top);
+            set_card_row_color(card_color(top));
+        } else {
+            // Background
+            set_card_row_color(COLOR_GREEN);
+            draw_bg();
+        }
+
+        card_draw_line_advance();
+    }
+#endif
+    PROF_EXIT(PROF_DRAW_STACK);
+}
@@ -0,0 +1,31 @@
+#ifndef _DRAW_H_
+#define _DRAW_H_
+
+#include <stdint.h>
+
+#include "screen.h"
+
+#define CARD_WIDTH  4
+#define CARD_HEIGHT 7
+#define CARD_WIDTH_PX   (CARD_WIDTH * 8)
+#define CARD_HEIGHT_PX  (CARD_HEIGHT * 8)
+
+#define LOWER_STACKS_Y      (CARD_HEIGHT + 2)
+#define NUM_LOWER_STACKS    8
+
+#define STACK_MAX_ROWS  (SCREEN_HEIGHT - LOWER_STACKS_Y)
+
+/* Redraw the dirty rows of a stack */
+void draw_stack(uint8_t stack);
+void draw_cell(uint8_t cell);
+void draw_done(uint8_t done);
+/* Draw a done pile showing card, whatever is on it now */
+void draw_done_card(uint8_t done, uint8_t card);
+
+/*
+ * Show a deal seed as four letters, A for hex digit 0 through P for F.
+ * Only the first digits letters are drawn, for showing one being typed.
+ */
+void draw_seed(uint16_t seed, uint8_t digits);
+
+#endif
@@ -0,0 +1,756 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "game.h"
+#include "screen.h"
+#include "draw.h"
+#include "deck.h"
+#include "prof.h"
+#include "journal.h"
+
+card_t stacks[NUM_STACKS][STACK_MAX_CARDS];
+uint8_t stack_height[NUM_STACKS];
+card_t stack_top[NUM_STACKS];
+card_t freecells[NUM_CELLS];
+card_t done_stack[4];
+bool game_over = false;
+
+/* The card each suit's done pile takes next, 0 once it's complete */
+static card_t done_next[NUM_SUITS];
+
+/*
+ * Auto-move state, kept up to date as cards move so check_moves() never
+ * has to look at the whole table. A card is free when it's on top of a
+ * stack or in a cell.
+ */
+/* Stacks and cells whose top card changed since check_moves() looked */
+static uint8_t check_stacks;
+static uint8_t check_cells;
+/* Stack, or NUM_STACKS + cell, plus 1 of each free card but the dragons */
+static uint8_t free_at[NUM_CARD_CODES];
+/* Free dragons of each suit, and the suits with all three free */
+static uint8_t free_dragons[NUM_SUITS];
+static uint8_t dragons_ready;
+/* Cards not yet on a done pile */
+static uint8_t table_cards;
+/* Flowers and dragons on done pile 3 */
+static uint8_t set_aside;
+
+static const uint8_t loc_bit[NUM_STACKS] = {
+    1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 1 << 6, 1 << 7,
+};
+
+const uint8_t suit_color[NUM_SUITS] = {
+    COLOR_RED, COLOR_GREEN, COLOR_BLACK,
+};
+
+/*
+ * Rule tables for card_stacks_on(), one row of 16 per suit. Only 1-9 can
+ * be stacked; everything else needs a number no card has.
+ */
+#define ROW_OF(v)   v, v, v, v, v, v, v, v, v, v, v, v, v, v, v, v
+#define STACK_ON_NUMBERS    0, 2, 3, 4, 5, 6, 7, 8, 9, 10, 0, 0, 0, 0, 0, 0
+
+const uint8_t stack_on_number[NUM_CARD_CODES] = {
+    STACK_ON_NUMBERS,
+    STACK_ON_NUMBERS,
+    STACK_ON_NUMBERS,
+};
+
+const uint8_t stack_on_suits[NUM_CARD_CODES] = {
+    ROW_OF((1 << GREEN) | (1 << BLACK)),
+    ROW_OF((1 << RED) | (1 << BLACK)),
+    ROW_OF((1 << RED) | (1 << GREEN)),
+};
+
+const uint8_t suit_bit[NUM_CARD_CODES] = {
+    ROW_OF(1 << RED),
+    ROW_OF(1 << GREEN),
+    ROW_OF(1 << BLACK),
+};
+
+/* The location where the held card was taken from */
+static uint8_t held_card_src_col;
+
+/* Have check_moves() look at a stack, or cell NUM_STACKS onwards */
+static void check_loc(uint8_t loc)
+{
+    if (loc < NUM_STACKS)
+        check_stacks |= loc_bit[loc];
+    else
+        check_cells |= loc_bit[loc - NUM_STACKS];
+}
+
+static void card_freed(card_t card, uint8_t loc)
+{
+    if (!card)
+        return;
+    if (card_number(card) == CARD_DRAGON) {
+        if (++free_dragons[card_suit(card)] == 3)
+            dragons_ready |= suit_bit[card];
+    } else {
+        free_at[card] = loc + 1;
+    }
+}
+
+static void card_covered(card_t card)
+{
+    if (!card)
+        return;
+    if (card_number(card) == CARD_DRAGON) {
+        free_dragons[card_suit(card)]--;
+        dragons_ready &= ~suit_bit[card];
+    } else {
+        free_at[card] = 0;
+    }
+}
+
+uint8_t stack_dirty_first[NUM_STACKS] = {
+    STACK_CLEAN, STACK_CLEAN, STACK_CLEAN, STACK_CLEAN,
+    STACK_CLEAN, STACK_CLEAN, STACK_CLEAN, STACK_CLEAN,
+};
+uint8_t stack_dirty_last[NUM_STACKS];
+
+/*
+ * Put a card (or 0) at a position in a stack. The card drawn there covers
+ * its own row plus the body rows below it, which is also exactly the set
+ * of rows that change when the top card is removed.
+ */
+static void set_stack_card(uint8_t stack, uint8_t pos, card_t card)
+{
+    uint8_t last = pos + CARD_HEIGHT - 1;
+
+    card_covered(stack_top[stack]);
+    stacks[stack][pos] = card;
+    if (card) {
+        stack_height[stack] = pos + 1;
+        stack_top[stack] = card;
+    } else {
+        stack_height[stack] = pos;
+        stack_top[stack] = pos ? stacks[stack][pos - 1] : 0;
+    }
+    card_freed(stack_top[stack], stack);
+    check_stacks |= loc_bit[stack];
+
+    if (last > STACK_MAX_ROWS - 1)
+        last = STACK_MAX_ROWS - 1;
+    if (pos < stack_dirty_first[stack])
+        stack_dirty_first[stack] = pos;
+    if (last > stack_dirty_last[stack])
+        stack_dirty_last[stack] = last;
+}
+
+/* Put a card (or 0) in a free cell */
+static void set_cell_card(uint8_t cell, card_t card)
+{
+    card_covered(freecells[cell]);
+    freecells[cell] = card;
+    card_freed(card, NUM_STACKS + cell);
+    check_cells |= loc_bit[cell];
+}
+
+static void set_done_stack(uint8_t done, uint8_t card)
+{
+    done_stack[done] = card;
+    if (done < NUM_SUITS) {
+        done_next[done] = card_number(card) == CARD9 ? 0 : card + 1;
+        /* The card that goes next may already be free */
+        if (free_at[done_next[done]])
+            check_loc(free_at[done_next[done]] - 1);
+    }
+}
+
+static void move_done_stack(uint8_t done, uint8_t card)
+{
+    set_done_stack(done, card);
+    draw_done(done);
+}
+
+/* Set by finish_game() while it leaves the drawing until the end */
+static bool batching;
+
+/* Take the top card off a stack or cell, and redraw it */
+static card_t pop_card(uint8_t loc)
+{
+    card_t card;
+
+    if (loc < NUM_STACKS) {
+        card = stack_top[loc];
+        set_stack_card(loc, stack_height[loc] - 1, 0);
+    } else {
+        card = freecells[loc - NUM_STACKS];
+        set_cell_card(loc - NUM_STACKS, 0);
+    }
+    if (!batching)
+        draw_stack(loc);
+    return card;
+}
+
+static void push_card(uint8_t loc, card_t card)
+{
+    if (loc < NUM_STACKS)
+        set_stack_card(loc, stack_height[loc], card);
+    else
+        set_cell_card(loc - NUM_STACKS, card);
+    draw_stack(loc);
+}
+
+/* Empty the table, and draw it so */
+static void clear_table(void)
+{
+    uint8_t i;
+
+    memset(stacks, 0, sizeof(stacks));
+    memset(stack_height, 0, sizeof(stack_height));
+    memset(stack_top, 0, sizeof(stack_top));
+    memset(freecells, 0, sizeof(freecells));
+    memset(done_stack, 0, sizeof(done_stack));
+    memset(free_at, 0, sizeof(free_at));
+    memset(free_dragons, 0, sizeof(free_dragons));
+    dragons_ready = 0;
+    check_stacks = 0;
+    check_cells = 0;
+    for (i=0; i<NUM_SUITS; i++) {
+        done_next[i] = make_card(CARD1, i);
+    }
+    table_cards = DECK_SIZE;
+    set_aside = 0;
+    game_over = false;
+    for (i=0; i<NUM_STACKS; i++) {
+        stack_dirty_first[i] = 0;
+        stack_dirty_last[i] = STACK_MAX_ROWS - 1;
+        draw_stack(i);
+    }
+    for (i=0; i<NUM_CELLS; i++) {
+        draw_cell(i);
+    }
+    for (i=0; i<4; i++) {
+        draw_done(i);
+    }
+}
+
+void cards(uint16_t seed)
+{
+    int i;
+    int j;
+    static card_t deck[DECK_SIZE];
+
+    PROF_ENTER(PROF_CARDS);
+
+    clear_table();
+    make_deck(deck, seed);
+
+    /* Deal them out */
+    j=0;
+    for(i = 0; i<NUM_STACKS; i++) {
+        set_stack_card(i, 0, deck[j++]);
+        draw_stack(i);
+    }
+    for(i = 0; i<NUM_STACKS; i++) {
+        set_stack_card(i, 1, deck[j++]);
+        draw_stack(i);
+    }
+    for(i = 0; i<NUM_STACKS; i++) {
+        set_stack_card(i, 2, deck[j++]);
+        draw_stack(i);
+    }
+    for(i = 0; i<NUM_STACKS; i++) {
+        set_stack_card(i, 3, deck[j++]);
+        draw_stack(i);
+    }
+    for(i = 0; i<6; i++) {
+        set_stack_card(i, 4, deck[j++]);
+        draw_stack(i);
+    }
+
+    check_moves();
+    /* Moves made dealing can't be undone */
+    journal_clear();
+    PROF_EXIT(PROF_CARDS);
+}
+
+uint8_t save_game(uint8_t *buf, uint16_t seed)
+{
+    uint8_t *p = buf;
+    uint8_t i;
+
+    *p++ = SAVE_VERSION;
+    *p++ = (uint8_t)seed;
+    *p++ = seed >> 8;
+    memcpy(p, freecells, NUM_CELLS);
+    p += NUM_CELLS;
+    memcpy(p, done_stack, sizeof(done_stack));
+    p += sizeof(done_stack);
+    *p++ = set_aside;
+    for (i = 0; i < NUM_STACKS; i++) {
+        *p++ = stack_height[i];
+        memcpy(p, stacks[i], stack_height[i]);
+        p += stack_height[i];
+    }
+    return p - buf;
+}
+
+/* Whether a card code is one make_deck() deals */
+static bool valid_card(card_t card)
+{
+    return card < NUM_CARD_CODES && card_number(card) >= CARD1 &&
+           card_number(card) <= CARD_FLOWER;
+}
+
+bool restore_game(const uint8_t *buf, uint8_t len, uint16_t *seed)
+{
+    const uint8_t *p;
+    const uint8_t *end = buf + len;
+    uint8_t i;
+    uint8_t j;
+
+    /* Check it all before touching the table */
+    if (len < SAVE_HEADER || buf[0] != SAVE_VERSION)
+        return false;
+    for (i = 0; i < NUM_CELLS; i++) {
+        if (buf[3 + i] && !valid_card(buf[3 + i]))
+            return false;
+    }
+    for (i = 0; i < 4; i++) {
+        if (buf[3 + NUM_CELLS + i] >= NUM_CARD_CODES)
+            return false;
+    }
+    p = buf + SAVE_HEADER;
+    for (i = 0; i < NUM_STACKS; i++) {
+        if (p == end || *p > STACK_MAX_CARDS || *p >= end - p)
+            return false;
+        for (j = 1; j <= *p; j++) {
+            if (!valid_card(p[j]))
+                return false;
+        }
+        p += *p + 1;
+    }
+
+    *seed = buf[1] | (buf[2] << 8);
+    clear_table();
+    table_cards = 0;
+    p = buf + 3;
+    for (i = 0; i < NUM_CELLS; i++, p++) {
+        set_cell_card(i, *p);
+        draw_cell(i);
+        if (*p)
+            table_cards++;
+    }
+    for (i = 0; i < 4; i++, p++) {
+        if (*p)
+            set_done_stack(i, *p);
+        draw_done(i);
+    }
+    set_aside = *p++;
+    for (i = 0; i < NUM_STACKS; i++) {
+        for (j = 0; j < *p; j++) {
+            set_stack_card(i, j, p[j + 1]);
+        }
+        table_cards += *p;
+        p += *p + 1;
+        draw_stack(i);
+    }
+
+    check_moves();
+    /* The journal was of the game before */
+    journal_clear();
+    return true;
+}
+
+card_t held_run[STACK_MAX_CARDS];
+
+static void drop_run_internal(uint8_t stack, uint8_t count);
+
+static void drop_run_cell(uint8_t stack, uint8_t count)
+{
+    uint8_t cell = stack - NUM_STACKS;
+
+    if (cell > NUM_CELLS-1)
+        cell = NUM_CELLS-1;
+
+    if (freecells[cell] || count > 1) {
+        /* Cell already occupied, or more than it can hold */
+        drop_run_internal(held_card_src_col, count);
+    } else {
+        set_cell_card(cell, held_run[0]);
+        draw_cell(cell);
+        /* stack may be past the last cell, which is where it went */
+        if (NUM_STACKS + cell != held_card_src_col)
+            journal_player(held_card_src_col, NUM_STACKS + cell, 1);
+    }
+}
+
+static void drop_run_internal(uint8_t stack, uint8_t count)
+{
+    uint8_t height;
+    uint8_t i;
+
+    if (stack >= NUM_STACKS) {
+        drop_run_cell(stack, count);
+        return;
+    }
+
+    height = stack_height[stack];
+    if (height + count > STACK_MAX_CARDS) {
+        drop_run_internal(held_card_src_col, count);
+        return;
+    }
+
+    for (i=0; i<count; i++) {
+        set_stack_card(stack, height + i, held_run[i]);
+    }
+    draw_stack(stack);
+    if (stack != held_card_src_col)
+        journal_player(held_card_src_col, stack, count);
+}
+
+void drop_run(uint8_t stack, uint8_t count)
+{
+    card_t top_card;
+
+    if (stack < NUM_STACKS) {
+        top_card = stack_top[stack];
+
+        /*
+         * Can always move onto an empty stack. Otherwise only by descending
+         * number and alternating color, and never a dragon from stack to
+         * stack
+         */
+        if (top_card && !card_stacks_on(held_run[0], top_card)) {
+            drop_run_internal(held_card_src_col, count);
+            return;
+        }
+    }
+
+    drop_run_internal(stack, count);
+}
+
+void drop_card(uint8_t stack, card_t held_card)
+{
+    held_run[0] = held_card;
+    drop_run(stack, 1);
+}
+
+static uint8_t take_card_cell(uint8_t stack)
+{
+    uint8_t cell = stack - NUM_STACKS;
+    uint8_t card;
+
+    if (cell > NUM_CELLS-1)
+        cell = NUM_CELLS-1;
+
+    card = freecells[cell];
+    if (!card)
+        return 0;
+
+    set_cell_card(cell, 0);
+    held_run[0] = card;
+    /* Illegal drops go back to this cell, which is now free */
+    held_card_src_col = NUM_STACKS + cell;
+    draw_cell(cell);
+    return 1;
+}
+
+uint8_t take_run(uint8_t stack, uint8_t row)
+{
+    uint8_t height;
+    uint8_t first;
+    uint8_t i;
+
+    if (stack >= NUM_STACKS) {
+        return take_card_cell(stack);
+    }
+
+    height = stack_height[stack];
+    if (!height)
+        return 0;
+
+    /* Start of the run at the top of the stack */
+    for (first = height-1; first > 0; first--) {
+        if (!card_stacks_on(stacks[stack][first], stacks[stack][first-1]))
+            break;
+    }
+    if (row > first)
+        first = row < height ? row : height-1;
+
+    /* Top down, so the caches follow each card taken */
+    for (i = height; i > first; i--) {
+        held_run[i-1 - first] = stacks[stack][i-1];
+        set_stack_card(stack, i-1, 0);
+    }
+    held_card_src_col = stack;
+    draw_stack(stack);
+
+    return height - first;
+}
+
+card_t take_card(uint8_t stack)
+{
+    return take_run(stack, STACK_MAX_CARDS) ? held_run[0] : 0;
+}
+
+/* Move the top card of a stack or cell to a done pile */
+static void move_to_done(uint8_t loc, uint8_t done)
+{
+    uint8_t row = loc < NUM_STACKS ? stack_height[loc] - 1 : 0;
+    card_t card = pop_card(loc);
+
+    if (done == 3) {
+        set_aside++;
+        set_done_stack(3, make_card(CARD_BACK, BLACK));
+        journal_set_aside(loc, card);
+    } else {
+        set_done_stack(done, card);
+        journal_done(loc, done);
+    }
+    table_cards--;
+    /* Draws the done pile once the card gets there */
+    animate_movement(card, loc, row, done);
+}
+
+/*
+ * Move the card at a stack or cell to a done pile, if it can go: flowers
+ * always, and numbers onto the one before.
+ */
+static void auto_move(uint8_t loc)
+{
+    card_t card;
+
+    if (loc < NUM_STACKS)
+        card = stack_top[loc];
+    else
+        card = freecells[loc - NUM_STACKS];
+    if (!card)
+        return;
+
+    if (card_number(card) == CARD_FLOWER)
+        move_to_done(loc, 3);
+    else if (card == done_next[card_suit(card)])
+        move_to_done(loc, card_suit(card));
+}
+
+/* Collect the three free dragons of a suit */
+static void remove_free_cards(card_t card)
+{
+    uint8_t i;
+
+    for (i=0; i<NUM_STACKS; i++) {
+        if (stack_top[i] == card)
+            move_to_done(i, 3);
+    }
+
+    for (i=0; i<NUM_CELLS; i++) {
+        if (freecells[i] == card)
+            move_to_done(NUM_STACKS + i, 3);
+    }
+}
+
+/*
+ * Make the automatic moves, only looking at the stacks and cells whose top
+ * card changed. Each move marks the stack or cell it came from, and the
+ * next card of that done pile if it's free, so a cascade follows itself.
+ */
+void check_moves(void)
+{
+    uint8_t i;
+
+    PROF_ENTER(PROF_CHECK_MOVES);
+    for (;;) {
+        if (check_stacks) {
+            for (i=0; !(check_stacks & loc_bit[i]); i++);
+            check_stacks &= ~loc_bit[i];
+            auto_move(i);
+        } else if (check_cells) {
+            for (i=0; !(check_cells & loc_bit[i]); i++);
+            check_cells &= ~loc_bit[i];
+            auto_move(NUM_STACKS + i);
+        } else if (dragons_ready) {
+            for (i=0; !(dragons_ready & suit_bit[make_card(CARD_DRAGON, i)]); i++);
+            remove_free_cards(make_card(CARD_DRAGON, i));
+        } else {
+            break;
+        }
+    }
+
+    if (!table_cards)
+        game_over = true;
+    PROF_EXIT(PROF_CHECK_MOVES);
+}
+
+/* Stacks and cells to take the finishing moves from, in order */
+static uint8_t finish_plan[DECK_SIZE];
+static uint8_t finish_count;
+
+/* Top card of a stack or cell in finish_ready()'s copy of the table */
+static card_t plan_top(const uint8_t *height, const card_t *cells, uint8_t loc)
+{
+    if (loc >= NUM_STACKS)
+        return cells[loc - NUM_STACKS];
+    return height[loc] ? stacks[loc][height[loc] - 1] : 0;
+}
+
+static void plan_pop(uint8_t *height, card_t *cells, uint8_t loc)
+{
+    finish_plan[finish_count++] = loc;
+    if (loc >= NUM_STACKS)
+        cells[loc - NUM_STACKS] = 0;
+    else
+        height[loc]--;
+}
+
+bool finish_ready(void)
+{
+    uint8_t height[NUM_STACKS];
+    card_t cells[NUM_CELLS];
+    card_t next[NUM_SUITS];
+    uint8_t loc;
+    uint8_t i;
+    uint8_t found;
+    bool moved;
+    card_t card;
+
+    memcpy(height, stack_height, sizeof(height));
+    memcpy(cells, freecells, sizeof(cells));
+    memcpy(next, done_next, sizeof(next));
+    finish_count = 0;
+
+    /* The moves check_moves() would make, until there are none */
+    do {
+        moved = false;
+        for (loc = 0; loc < NUM_STACKS + NUM_CELLS; loc++) {
+            card = plan_top(height, cells, loc);
+            if (!card)
+                continue;
+            if (card_number(card) == CARD_FLOWER) {
+                plan_pop(height, cells, loc);
+            } else if (card == next[card_suit(card)]) {
+                next[card_suit(card)] = card_number(card) == CARD9 ? 0 : card + 1;
+                plan_pop(height, cells, loc);
+            } else if (card_number(card) == CARD_DRAGON) {
+                /* All three free, which is one on top of each of three */
+                for (i = 0, found = 0; i < NUM_STACKS + NUM_CELLS; i++) {
+                    if (plan_top(height, cells, i) == card)
+                        found++;
+                }
+                if (found != 3)
+                    continue;
+                for (i = 0; i < NUM_STACKS + NUM_CELLS; i++) {
+                    if (plan_top(height, cells, i) == card)
+                        plan_pop(height, cells, i);
+                }
+            } else {
+                continue;
+            }
+            moved = true;
+        }
+    } while (moved);
+
+    return finish_count == table_cards;
+}
+
+void finish_game(void)
+{
+    uint8_t i;
+    uint8_t loc;
+    card_t card;
+
+    batching = true;
+    for (i = 0; i < finish_count; i++) {
+        loc = finish_plan[i];
+        card = loc < NUM_STACKS ? stack_top[loc] : freecells[loc - NUM_STACKS];
+        if (card_number(card) == CARD_FLOWER || card_number(card) == CARD_DRAGON)
+            move_to_done(loc, 3);
+        else
+            move_to_done(loc, card_suit(card));
+    }
+    batching = false;
+
+    /* Each stack and cell once, for every card taken from it */
+    for (i = 0; i < NUM_STACKS + NUM_CELLS; i++)
+        draw_stack(i);
+    /* Nothing left to move, but it ends the game */
+    check_moves();
+}
+
+/* Take a move from the journal back */
+static void unmake_move(const struct journal_move *m)
+{
+    uint8_t i;
+    card_t card;
+
+    switch (m->kind) {
+    case JOURNAL_PLAYER:
+        /* Top down into held_run, then back in order */
+        for (i = m->count; i > 0; i--)
+            held_run[i-1] = pop_card(m->dst);
+        for (i = 0; i < m->count; i++)
+            push_card(m->src, held_run[i]);
+        break;
+    case JOURNAL_DONE:
+        card = done_stack[m->dst];
+        done_stack[m->dst] = card_number(card) == CARD1 ? 0 : card - 1;
+        done_next[m->dst] = card;
+        draw_done(m->dst);
+        push_card(m->src, card);
+        table_cards++;
+        break;
+    case JOURNAL_SET_ASIDE:
+        if (!--set_aside)
+            move_done_stack(3, 0);
+        push_card(m->src, m->card);
+        table_cards++;
+        break;
+    }
+}
+
+/* Make a move from the journal again */
+static void remake_move(const struct journal_move *m)
+{
+    uint8_t i;
+
+    switch (m->kind) {
+    case JOURNAL_PLAYER:
+        for (i = m->count; i > 0; i--)
+            held_run[i-1] = pop_card(m->src);
+        for (i = 0; i < m->count; i++)
+            push_card(m->dst, held_run[i]);
+        break;
+    case JOURNAL_DONE:
+        move_done_stack(m->dst, pop_card(m->src));
+        table_cards--;
+        break;
+    case JOURNAL_SET_ASIDE:
+        pop_card(m->src);
+        set_aside++;
+        move_done_stack(3, make_card(CARD_BACK, BLACK));
+        table_cards--;
+        break;
+    }
+}
+
+bool undo_move(void)
+{
+    struct journal_move m;
+
+    do {
+        if (!journal_back(&m))
+            return false;
+        unmake_move(&m);
+    } while (m.kind != JOURNAL_PLAYER);
+    game_over = false;
+    return true;
+}
+
+bool redo_move(void)
+{
+    struct journal_move m;
+
+    if (!journal_forward(&m, false))
+        return false;
+    do {
+        remake_move(&m);
+    } while (journal_forward(&m, true));
+    game_over = !table_cards;
+    return true;
+}
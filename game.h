@@ -0,0 +1,144 @@
+#ifndef _GAME_H_
+#define _GAME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hal.h"
+
+/*
+ * Rules and board state. Nothing in here touches the hardware: drawing goes
+ * through draw.h and everything else through hal.h.
+ */
+
+enum card_id {
+    CARD0 = 0,
+    CARD1 = 1,
+    CARD2 = 2,
+    CARD3 = 3,
+    CARD4 = 4,
+    CARD5 = 5,
+    CARD6 = 6,
+    CARD7 = 7,
+    CARD8 = 8,
+    CARD9 = 9,
+    CARD_DRAGON = 10,
+    CARD_FLOWER = 11,
+    CARD_BACK = 12,
+};
+
+/* Also the index of the suit's done pile */
+enum suit {
+    RED = 0,
+    GREEN = 1,
+    BLACK = 2,
+    NUM_SUITS,
+};
+
+typedef uint8_t card_t;
+
+#define card_number(card)       (card & 0xf)
+#define card_suit(card)         (card >> 4)
+#define make_card(number, suit) ((suit << 4) | number)
+
+/* Every card_t value, for tables indexed by card */
+#define NUM_CARD_CODES  (NUM_SUITS << 4)
+
+/* C64 color each suit is drawn in */
+extern const uint8_t suit_color[NUM_SUITS];
+#define card_color(card)        (suit_color[card_suit(card)])
+
+/*
+ * Whether card can be stacked on under: one lower and of another suit,
+ * and never a dragon. One compare and one AND on tables indexed by card.
+ */
+extern const uint8_t stack_on_number[NUM_CARD_CODES];
+extern const uint8_t stack_on_suits[NUM_CARD_CODES];
+extern const uint8_t suit_bit[NUM_CARD_CODES];
+#define card_stacks_on(card, under) \
+    (card_number(under) == stack_on_number[card] && \
+     (stack_on_suits[card] & suit_bit[under]))
+
+/* Card positions */
+
+#define NUM_STACKS      8
+#define STACK_MAX_CARDS 10
+extern card_t stacks[NUM_STACKS][STACK_MAX_CARDS];
+/* Kept up to date with stacks: cards in each, and the top one (0 if empty) */
+extern uint8_t stack_height[NUM_STACKS];
+extern card_t stack_top[NUM_STACKS];
+#define NUM_CELLS       3
+extern card_t freecells[NUM_CELLS];
+extern card_t done_stack[4];
+
+#define DECK_SIZE 38
+
+extern bool game_over;
+
+/*
+ * Range of screen rows in each lower stack that changed since it was last
+ * drawn. draw_stack() only touches these rows.
+ */
+#define STACK_CLEAN 0xff
+extern uint8_t stack_dirty_first[NUM_STACKS];
+extern uint8_t stack_dirty_last[NUM_STACKS];
+
+/* Shuffle and deal a new game. The same seed always gives the same deal. */
+void cards(uint16_t seed);
+
+/*
+ * Saved games: SAVE_VERSION, the deal seed (low byte first), the free
+ * cells, the done piles and the number of cards set aside, then for each
+ * stack its height followed by its cards, bottom first.
+ */
+#define SAVE_VERSION    1
+#define SAVE_HEADER     (3 + NUM_CELLS + 4 + 1)
+#define SAVE_MAX        (SAVE_HEADER + NUM_STACKS + DECK_SIZE)
+
+/* Write the game to buf, returning how many bytes that took */
+uint8_t save_game(uint8_t *buf, uint16_t seed);
+
+/*
+ * Play on from a game save_game() wrote, with its seed put in seed.
+ * Returns false, leaving the game as it was, if buf doesn't hold one.
+ */
+bool restore_game(const uint8_t *buf, uint8_t len, uint16_t *seed);
+
+/*
+ * Pick up cards from a stack, from row to the top. Only a run of descending
+ * numbers in alternating colors can be picked up; a row below the start of
+ * the run at the top of the stack takes the whole run. A stack of
+ * NUM_STACKS or more is a free cell, which holds one card. Returns how many
+ * cards were taken, into held_run[] bottom first, or 0 if there were none.
+ */
+uint8_t take_run(uint8_t stack, uint8_t row);
+extern card_t held_run[STACK_MAX_CARDS];
+
+/* Drop the count cards taken with take_run(). Illegal moves send them back. */
+void drop_run(uint8_t stack, uint8_t count);
+
+/* take_run() and drop_run() for just the top card */
+card_t take_card(uint8_t stack);
+void drop_card(uint8_t stack, card_t card);
+
+/* Make any automatic moves to the done piles */
+void check_moves(void);
+
+/*
+ * Whether the automatic moves alone would clear the table from here, worked
+ * out on a copy without moving or drawing anything. If so, finish_game()
+ * makes them, drawing the stacks and cells once at the end rather than
+ * after each card, in place of check_moves().
+ */
+bool finish_ready(void);
+void finish_game(void);
+
+/*
+ * Undo the last player move along with the automatic moves it led to, or
+ * redo the last one undone. Only the stacks and cells involved are
+ * redrawn. Return false if there was nothing to undo or redo.
+ */
+bool undo_move(void);
+bool redo_move(void);
+
+#endif
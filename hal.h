@@ -0,0 +1,49 @@
+#ifndef _HAL_H_
+#define _HAL_H_
+
+#include <stdint.h>
+
+/*
+ * What the rules and drawing code need from the platform. On the C64 that is
+ * cc65's hardware definitions plus the functions below, implemented in
+ * main.c. The host build (host.c) provides plain memory and stubs instead.
+ */
+
+#ifdef __CC65__
+#include <cbm.h>
+#else
+#define fastcall
+
+enum {
+    COLOR_BLACK = 0,
+    COLOR_WHITE,
+    COLOR_RED,
+    COLOR_CYAN,
+    COLOR_VIOLET,
+    COLOR_GREEN,
+    COLOR_BLUE,
+    COLOR_YELLOW,
+    COLOR_ORANGE,
+    COLOR_BROWN,
+    COLOR_LIGHTRED,
+    COLOR_GRAY1,
+    COLOR_GRAY2,
+    COLOR_LIGHTGREEN,
+    COLOR_LIGHTBLUE,
+    COLOR_GRAY3,
+};
+
+extern uint8_t COLOR_RAM[];
+#endif
+
+/* A random byte, for shuffling */
+uint8_t hal_rand(void);
+
+/*
+ * Show a card flying from a stack (or free cell, NUM_STACKS + cell) to one
+ * of the done piles, after any already on their way. When it gets there the
+ * pile is drawn as done_stack[dest] is now. May return before it has.
+ */
+void animate_movement(uint8_t card, uint8_t src_stack, uint8_t row, uint8_t dest);
+
+#endif
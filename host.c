@@ -0,0 +1,72 @@
+/*
+ * Host build of the game engine. The rules (game.c) and the drawing code
+ * (draw.c) run unchanged against in-memory screen and color buffers, with a
+ * random player in place of the joystick. Useful for testing and profiling
+ * the engine without an emulator:
+ *
+ *     make host && ./shenzhen-host [games] [seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "game.h"
+#include "screen.h"
+#include "charset.h"
+#include "draw.h"
+#include "host.h"
+
+/* Give up on a game after this many player moves */
+#define MAX_MOVES 2000
+
+/* Pick up from a random stack row or cell and drop it somewhere random */
+static unsigned long play_game(void)
+{
+    unsigned long moves;
+    uint8_t count;
+
+    cards((uint16_t)host_rand());
+    for (moves = 0; moves < MAX_MOVES && !game_over; moves++) {
+        count = take_run(host_rand() % (NUM_STACKS + NUM_CELLS),
+                         host_rand() % STACK_MAX_CARDS);
+        if (!count)
+            continue;
+        drop_run(host_rand() % (NUM_STACKS + NUM_CELLS), count);
+        check_moves();
+    }
+    return moves;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long games = 10000;
+    unsigned long moves = 0;
+    unsigned long won = 0;
+    unsigned long i;
+    clock_t start;
+    double secs;
+
+    if (argc > 1)
+        games = strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        host_srand(strtoul(argv[2], NULL, 0));
+
+    start = clock();
+    for (i = 0; i < games; i++) {
+        moves += play_game();
+        if (game_over)
+            won++;
+    }
+    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("games:      %lu\n", games);
+    printf("won:        %lu\n", won);
+    printf("moves:      %lu\n", moves);
+    printf("auto moves: %lu\n", host_auto_moves);
+    printf("time:       %.3fs\n", secs);
+    if (secs > 0)
+        printf("moves/sec:  %.0f\n", (moves + host_auto_moves) / secs);
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include <stdint.h>
+
+/*
+ * The hal.h implementation shared by the host tools (hosthal.c): screen and
+ * color memory are plain arrays and animations only count.
+ */
+
+/* Auto moves animate_movement() has been asked to show */
+extern unsigned long host_auto_moves;
+
+/* Seed and draw from the generator behind hal_rand() */
+void host_srand(uint32_t seed);
+uint32_t host_rand(void);
+
+#endif
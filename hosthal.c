@@ -0,0 +1,51 @@
+#include <stdint.h>
+
+#include "game.h"
+#include "screen.h"
+#include "charset.h"
+#include "draw.h"
+#include "host.h"
+
+struct screen_memory SCREENMEM;
+uint8_t COLOR_RAM[SCREENMEM_SIZE];
+
+unsigned long host_auto_moves;
+
+/* Drawing goes straight to the one page */
+void screen_mark(uint8_t slot, uint8_t first, uint8_t last)
+{
+    (void)slot;
+    (void)first;
+    (void)last;
+}
+
+static uint32_t rng_state = 1;
+
+void host_srand(uint32_t seed)
+{
+    rng_state = seed ? seed : 1;
+}
+
+/* xorshift32 */
+uint32_t host_rand(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+uint8_t hal_rand(void)
+{
+    return (uint8_t)(host_rand() >> 24);
+}
+
+/* Lands at once */
+void animate_movement(uint8_t card, uint8_t src_stack, uint8_t row, uint8_t dest)
+{
+    (void)card;
+    (void)src_stack;
+    (void)row;
+    draw_done(dest);
+    host_auto_moves++;
+}
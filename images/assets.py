@@ -0,0 +1,297 @@
+#!/usr/bin/env python3
+#
+# Asset compiler for the character set and sprites.
+#
+# Reads the 1 bit .bmp images (exported from the .xcf sources), makes the
+# glyphs the cards need from them, drops any glyph that is the same as one
+# already placed and lays the rest out after the ROM characters in CHARMEM.
+# Sprites are laid out one per 64 bytes, again without duplicates, then a
+# frame of each card face for every card number, so showing a held card is
+# only a sprite pointer.
+#
+# Writes:
+#   assets.h    the glyph indexes and sprite symbols for C
+#   assets.inc  the edge indexes for ca65, and ASSET_GLYPHS and ASSET_SPRITES
+#               macros that charset.s expands where the data goes
+#   assets.lst  a listing of where everything went
+#
+# Usage: assets.py IMAGE_DIR OUTPUT_DIR
+
+import os
+import struct
+import sys
+
+# Characters copied from the ROM to the start of CHARMEM, see screen.c
+ROM_CHARS = 33
+# Extended background color mode only shows the first 64
+MAX_CHARS = 64
+
+# Card numbers 1 to 12, in the order card_number() gives them. The top left
+# corner shows the image as drawn, the bottom right one upside down.
+CORNERS = [
+    "1", "2", "3", "4", "5", "6", "7", "8", "9",
+    "dragon", "flower", "blank",
+]
+
+# Card edges, which are simple enough to give here
+EDGES = [
+    ("TOP",         [0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00]),
+    ("RIGHT",       [0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01]),
+    ("BOTTOM",      [0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff]),
+    ("BOTTOM_LEFT", [0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x7f]),
+    ("TOP_RIGHT",   [0xfe, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01]),
+    ("LEFT",        [0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80]),
+]
+
+# Symbol name and image of each sprite
+SPRITES = [
+    ("CARD_BG",     "cardsprite_bg"),
+    ("MOUSE",       "mouse_sprite"),
+]
+
+# Card numbers that can be picked up, which is all but the back
+FRAME_CORNERS = CORNERS[:-1]
+# Images the card frames are made from
+FRAME_TOP = "cardsprite_top"
+FRAME_BOTTOM = "cardsprite_bottom"
+# Row and byte the corners go at in them. The bottom one starts at row 21
+# of the card, and the bottom right corner is at row 26, byte 2.
+TOP_LEFT_AT = (0, 0)
+BOTTOM_RIGHT_AT = (26 - 21, 2)
+# The rows of a label, the part of a card showing above the next one
+LABEL_ROWS = 8
+
+GLYPH_SIZE = 8
+SPRITE_WIDTH = 24
+SPRITE_HEIGHT = 21
+SPRITE_SIZE = 64
+
+
+def fail(msg):
+    sys.exit("assets.py: " + msg)
+
+
+def read_bmp(path):
+    """Rows of bytes, top first, 8 pixels a byte with the leftmost in bit 7.
+    Dark pixels are set."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:2] != b"BM":
+        fail("%s: not a BMP" % path)
+    pixels, = struct.unpack_from("<I", data, 10)
+    header, width, height, _, bpp, compression = struct.unpack_from("<IiiHHI", data, 14)
+    if bpp != 1 or compression != 0:
+        fail("%s: only uncompressed 1 bit images are supported" % path)
+
+    # Index 1 is whichever palette entry is dark
+    palette = 14 + header
+    lum = []
+    for i in range(2):
+        b, g, r = data[palette + i * 4:palette + i * 4 + 3]
+        lum.append(r * 3 + g * 6 + b)
+    invert = lum[1] > lum[0]
+
+    stride = (width + 31) // 32 * 4
+    row_bytes = (width + 7) // 8
+    rows = []
+    for y in range(abs(height)):
+        # Bottom up unless the height is negative
+        line = y if height < 0 else abs(height) - 1 - y
+        start = pixels + line * stride
+        row = bytearray(data[start:start + row_bytes])
+        if invert:
+            row = bytearray(b ^ 0xff for b in row)
+        if width % 8:
+            row[-1] &= (0xff << (8 - width % 8)) & 0xff
+        rows.append(bytes(row))
+    return width, abs(height), rows
+
+
+def reverse_bits(b):
+    return int("{:08b}".format(b)[::-1], 2)
+
+
+def upside_down(glyph):
+    """Turned half a turn, like convert -flip -flop"""
+    return bytes(reverse_bits(b) for b in reversed(glyph))
+
+
+def load_glyph(image_dir, name):
+    width, height, rows = read_bmp(os.path.join(image_dir, name + ".bmp"))
+    if (width, height) != (8, GLYPH_SIZE):
+        fail("%s.bmp: glyphs are 8x8, not %dx%d" % (name, width, height))
+    return b"".join(rows)
+
+
+def load_sprite(image_dir, name):
+    width, height, rows = read_bmp(os.path.join(image_dir, name + ".bmp"))
+    if (width, height) != (SPRITE_WIDTH, SPRITE_HEIGHT):
+        fail("%s.bmp: sprites are %dx%d, not %dx%d" %
+             (name, SPRITE_WIDTH, SPRITE_HEIGHT, width, height))
+    return b"".join(rows) + bytes(SPRITE_SIZE - SPRITE_WIDTH // 8 * SPRITE_HEIGHT)
+
+
+def with_glyph(sprite, glyph, at):
+    """The sprite with the glyph drawn over it, byte aligned"""
+    row, col = at
+    frame = bytearray(sprite)
+    for i, b in enumerate(glyph):
+        frame[(row + i) * SPRITE_WIDTH // 8 + col] = b
+    return bytes(frame)
+
+
+def card_frames(image_dir, glyphs):
+    """Top, bottom and label frames of each of FRAME_CORNERS, in order"""
+    top = load_sprite(image_dir, FRAME_TOP)
+    bottom = load_sprite(image_dir, FRAME_BOTTOM)
+    label_size = LABEL_ROWS * SPRITE_WIDTH // 8
+    tops, bottoms, labels = [], [], []
+    for name in FRAME_CORNERS:
+        glyph = glyphs[name]
+        frame = with_glyph(top, glyph, TOP_LEFT_AT)
+        tops.append(frame)
+        bottoms.append(with_glyph(bottom, upside_down(glyph), BOTTOM_RIGHT_AT))
+        labels.append(frame[:label_size] + bytes(SPRITE_SIZE - label_size))
+    return [("CARD_TOPS", tops), ("CARD_BOTTOMS", bottoms), ("CARD_LABELS", labels)]
+
+
+class Packer:
+    """Places blocks of data in order, reusing any identical one"""
+
+    def __init__(self, first):
+        self.first = first
+        self.blocks = []
+        self.names = []
+
+    def place(self, name, data):
+        if data in self.blocks:
+            i = self.blocks.index(data)
+            self.names[i].append(name)
+        else:
+            i = len(self.blocks)
+            self.blocks.append(data)
+            self.names.append([name])
+        return self.first + i
+
+
+def byte_lines(data, indent="    "):
+    return [indent + ".byte   " + ", ".join("$%02x" % b for b in data[i:i + 8])
+            for i in range(0, len(data), 8)]
+
+
+def main():
+    if len(sys.argv) != 3:
+        fail("usage: assets.py IMAGE_DIR OUTPUT_DIR")
+    image_dir, out_dir = sys.argv[1:]
+
+    glyphs = Packer(ROM_CHARS)
+    corners = {}
+    top_left = []
+    bottom_right = []
+    for name in CORNERS:
+        glyph = corners[name] = load_glyph(image_dir, name)
+        top_left.append(glyphs.place(name, glyph))
+        bottom_right.append(glyphs.place(name + " upside down", upside_down(glyph)))
+    edges = [(name, glyphs.place(name.lower(), data)) for name, data in EDGES]
+    end = glyphs.first + len(glyphs.blocks)
+    if end > MAX_CHARS:
+        fail("%d characters, only %d can be shown" % (end, MAX_CHARS))
+
+    sprites = Packer(0)
+    sprite_slots = [(name, sprites.place(name, load_sprite(image_dir, image)))
+                    for name, image in SPRITES]
+    frames = card_frames(image_dir, corners)
+
+    # Index 0 is no card
+    top_left = [0] + top_left
+    bottom_right = [0] + bottom_right
+
+    header = "Generated by images/assets.py, do not edit"
+    h = ["/* %s */" % header,
+         "#ifndef _ASSETS_H_",
+         "#define _ASSETS_H_",
+         "",
+         "#include <stdint.h>",
+         "",
+         "/* Character indexes of the card edges */"]
+    h += ["#define CARD_IDX_%s %d" % (name, idx) for name, idx in edges]
+    h += ["",
+          "/* Character indexes of the card corners, by card number */",
+          "#define CARD_GLYPHS_TOP_LEFT { %s }" % ", ".join(map(str, top_left)),
+          "#define CARD_GLYPHS_BOTTOM_RIGHT { %s }" % ", ".join(map(str, bottom_right)),
+          "#define NUM_CARD_GLYPHS %d" % len(top_left),
+          "",
+          "/* First character free after the glyphs */",
+          "#define ASSET_CHARS_END %d" % end,
+          "",
+          "/* Sprite data, and the value for a sprite pointer to show it */"]
+    for name, _ in sprite_slots:
+        h += ["extern uint8_t SPRITE_%s[%d];" % (name, SPRITE_SIZE),
+              "extern uint8_t SPRITE_PTR_%s;" % name]
+    h += ["",
+          "/*",
+          " * Card frames, one for each card number from 1, one after the other so",
+          " * number n is shown with a sprite pointer of SPRITE_PTR_... + n - 1",
+          " */",
+          "#define NUM_CARD_FRAMES %d" % len(FRAME_CORNERS)]
+    for name, _ in frames:
+        h += ["extern uint8_t SPRITE_%s[NUM_CARD_FRAMES][%d];" % (name, SPRITE_SIZE),
+              "extern uint8_t SPRITE_PTR_%s;" % name]
+    h += ["", "#endif"]
+
+    inc = ["; %s" % header, ""]
+    inc += ["CARD_IDX_%s = %d" % (name, idx) for name, idx in edges]
+    inc += ["ASSET_CHARS_END = %d" % end,
+            "",
+            "; Goes right after the ROM characters in CHARMEM",
+            ".macro ASSET_GLYPHS"]
+    for data, names in zip(glyphs.blocks, glyphs.names):
+        inc.append("    ; %s" % ", ".join(names))
+        inc += byte_lines(data)
+    inc += [".endmacro",
+            "",
+            "; Goes 64 byte aligned in the VIC bank",
+            ".macro ASSET_SPRITES"]
+    for i, data in enumerate(sprites.blocks):
+        inc.append("    .align  %d" % SPRITE_SIZE)
+        for name, slot in sprite_slots:
+            if slot == i:
+                inc += ["    .export _SPRITE_%s, _SPRITE_PTR_%s" % (name, name),
+                        "_SPRITE_%s:" % name,
+                        "_SPRITE_PTR_%s = _SPRITE_%s / %d" % (name, name, SPRITE_SIZE)]
+        inc += byte_lines(data)
+    for name, data in frames:
+        inc += ["    .align  %d" % SPRITE_SIZE,
+                "    .export _SPRITE_%s, _SPRITE_PTR_%s" % (name, name),
+                "_SPRITE_%s:" % name,
+                "_SPRITE_PTR_%s = _SPRITE_%s / %d" % (name, name, SPRITE_SIZE)]
+        for corner, frame in zip(FRAME_CORNERS, data):
+            inc.append("    ; %s" % corner)
+            inc += byte_lines(frame)
+    inc += [".endmacro"]
+
+    lst = ["%s" % header, "",
+           "Characters %d-%d of %d, %d saved by reuse" %
+           (ROM_CHARS, end - 1, MAX_CHARS,
+            sum(len(n) - 1 for n in glyphs.names))]
+    for i, names in enumerate(glyphs.names):
+        lst.append("  %2d  %s" % (glyphs.first + i, ", ".join(names)))
+    lst += ["", "Sprites, %d bytes, %d saved by reuse" %
+            (len(sprites.blocks) * SPRITE_SIZE,
+             sum(len(n) - 1 for n in sprites.names) * SPRITE_SIZE)]
+    for i, names in enumerate(sprites.names):
+        lst.append("  +$%03x  %s" % (i * SPRITE_SIZE, ", ".join(names)))
+    at = len(sprites.blocks) * SPRITE_SIZE
+    lst += ["", "Card frames, %d bytes" %
+            (len(frames) * len(FRAME_CORNERS) * SPRITE_SIZE)]
+    for name, data in frames:
+        lst.append("  +$%03x  %s, %s" % (at, name, ", ".join(FRAME_CORNERS)))
+        at += len(data) * SPRITE_SIZE
+
+    for name, lines in (("assets.h", h), ("assets.inc", inc), ("assets.lst", lst)):
+        with open(os.path.join(out_dir, name), "w") as f:
+            f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()
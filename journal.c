@@ -0,0 +1,114 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "game.h"
+#include "journal.h"
+
+/*
+ * Encoding, first byte first:
+ *     player move     src << 4 | dst, PLAYER_COUNT | count
+ *     done pile       DONE_TAG + (suit << 4) | src
+ *     set aside       SET_ASIDE_TAG | src, card
+ * Locations fit in 4 bits. The kind can be told from the first byte going
+ * forward and from the last byte going back, as a card byte is never more
+ * than 0x2f.
+ */
+#define PLAYER_COUNT    0x80
+#define DONE_TAG        0xc0
+#define SET_ASIDE_TAG   0xf0
+
+/* 256 bytes so the indexes wrap on their own */
+static uint8_t buf[256];
+/* Moves from tail to cursor can be undone, from cursor to head redone */
+static uint8_t tail;
+static uint8_t cursor;
+static uint8_t head;
+
+void journal_clear(void)
+{
+    tail = 0;
+    cursor = 0;
+    head = 0;
+}
+
+/* Size of the move starting with byte */
+static uint8_t move_size(uint8_t byte)
+{
+    return byte >= DONE_TAG && byte < SET_ASIDE_TAG ? 1 : 2;
+}
+
+/* Drop the oldest player move and its automatic moves */
+static void drop_oldest(void)
+{
+    do {
+        tail += move_size(buf[tail]);
+    } while (tail != cursor && buf[tail] >= DONE_TAG);
+}
+
+static void put(uint8_t byte)
+{
+    if ((uint8_t)(cursor + 1) == tail)
+        drop_oldest();
+    buf[cursor++] = byte;
+    head = cursor;
+}
+
+void journal_player(uint8_t src, uint8_t dst, uint8_t count)
+{
+    put(src << 4 | dst);
+    put(PLAYER_COUNT | count);
+}
+
+void journal_done(uint8_t src, uint8_t suit)
+{
+    put(DONE_TAG + (suit << 4) | src);
+}
+
+void journal_set_aside(uint8_t src, card_t card)
+{
+    put(SET_ASIDE_TAG | src);
+    put(card);
+}
+
+/* Decode the move at pos */
+static void decode(uint8_t pos, struct journal_move *m)
+{
+    uint8_t byte = buf[pos];
+
+    m->src = byte & 0xf;
+    if (byte >= SET_ASIDE_TAG) {
+        m->kind = JOURNAL_SET_ASIDE;
+        m->card = buf[(uint8_t)(pos + 1)];
+    } else if (byte >= DONE_TAG) {
+        m->kind = JOURNAL_DONE;
+        m->dst = (byte - DONE_TAG) >> 4;
+    } else {
+        m->kind = JOURNAL_PLAYER;
+        m->src = byte >> 4;
+        m->dst = byte & 0xf;
+        m->count = buf[(uint8_t)(pos + 1)] & ~PLAYER_COUNT;
+    }
+}
+
+bool journal_back(struct journal_move *m)
+{
+    uint8_t last;
+
+    if (cursor == tail)
+        return false;
+    last = buf[(uint8_t)(cursor - 1)];
+    cursor -= last >= DONE_TAG ? 1 : 2;
+    decode(cursor, m);
+    return true;
+}
+
+bool journal_forward(struct journal_move *m, bool automatic)
+{
+    if (cursor == head)
+        return false;
+    if (automatic && buf[cursor] < DONE_TAG)
+        return false;
+    decode(cursor, m);
+    cursor += move_size(buf[cursor]);
+    return true;
+}
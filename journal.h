@@ -0,0 +1,49 @@
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "game.h"
+
+/*
+ * Ring buffer of the moves made since the deal, for undo and redo. A
+ * player move takes 2 bytes and each automatic move after it 1, or 2 for
+ * a flower or dragon, so no board is ever copied. Once the buffer is full
+ * the oldest player moves are dropped, with their automatic moves.
+ *
+ * Locations are stacks, or NUM_STACKS + cell, as for take_run().
+ */
+
+enum journal_kind {
+    JOURNAL_PLAYER,     /* count cards from src to dst */
+    JOURNAL_DONE,       /* The top card of src to its suit's done pile */
+    JOURNAL_SET_ASIDE,  /* card, a flower or dragon, from src to done pile 3 */
+};
+
+struct journal_move {
+    uint8_t kind;
+    uint8_t src;
+    uint8_t dst;
+    uint8_t count;
+    card_t card;
+};
+
+/* Forget every move, for a new deal */
+void journal_clear(void);
+
+/* Record a move. A player move drops any moves that were undone. */
+void journal_player(uint8_t src, uint8_t dst, uint8_t count);
+void journal_done(uint8_t src, uint8_t suit);
+void journal_set_aside(uint8_t src, card_t card);
+
+/* Step back over the last move made. Returns false if there is none. */
+bool journal_back(struct journal_move *m);
+
+/*
+ * Step forward over the next move undone. With automatic set, only if it
+ * isn't a player move. Returns false if there is none.
+ */
+bool journal_forward(struct journal_move *m, bool automatic);
+
+#endif
@@ -6,306 +6,22 @@
 #include <cbm.h>
 #include <6502.h>
 
+#include "game.h"
 #include "screen.h"
 #include "charset.h"
-
-#define USE_ASM 1
-
-enum card_id {
-    CARD0 = 0,
-    CARD1 = 1,
-    CARD2 = 2,
-    CARD3 = 3,
-    CARD4 = 4,
-    CARD5 = 5,
-    CARD6 = 6,
-    CARD7 = 7,
-    CARD8 = 8,
-    CARD9 = 9,
-    CARD_DRAGON = 10,
-    CARD_FLOWER = 11,
-    CARD_BACK = 12,
-};
-
-enum suit {
-    RED = COLOR_RED,
-    GREEN = COLOR_GREEN,
-    BLACK = COLOR_BLACK,
-};
-
-typedef uint8_t card_t;
-
-#define card_number(card)       (card & 0xf)
-#define card_color(card)         (card >> 4)
-#define make_card(number, color) ((color << 4) | number)
-
-/* Cursor position */
-static uint16_t posx;
-static uint8_t posy;
-/* ID of card held by cursor. 0 if none */
-static uint8_t held_card;
-/* The location where the card was taken from */
-static uint8_t held_card_src_col;
-static bool game_over = false;
-/* Pointer into screen memory where card drawing is taking place (avoids parameter passing) */
-uint8_t *card_draw_screenpos;
-/* Same as above for color ram */
-uint8_t *card_draw_colorpos;
-
-/* Card positions */
-
-#define NUM_STACKS      8
-#define STACK_MAX_CARDS 10
-static card_t stacks[NUM_STACKS][STACK_MAX_CARDS];
-#define NUM_CELLS       3
-static card_t freecells[NUM_CELLS];
-static card_t done_stack[4];
-
-#define CARD_WIDTH  4
-#define CARD_HEIGHT 7
-#define CARD_WIDTH_PX   (CARD_WIDTH * 8)
-#define CARD_HEIGHT_PX  (CARD_HEIGHT * 8)
-
-#define LOWER_STACKS_Y      (CARD_HEIGHT + 2)
-#define NUM_LOWER_STACKS    8
-
-#define STACK_MAX_ROWS  (SCREEN_HEIGHT - LOWER_STACKS_Y)
-
-/* Fill one row of a card's color memory */
-#if !USE_ASM
-static void fastcall set_card_row_color(uint8_t color)
-{
-    memset(card_draw_colorpos, color, CARD_WIDTH);
-}
-#else
-extern void fastcall asm_set_card_row_color(uint8_t color);
-#define set_card_row_color(color) asm_set_card_row_color(color)
-#endif
-
-static void card_draw_line_advance(void)
-{
-    card_draw_screenpos += SCREEN_WIDTH;
-    card_draw_colorpos += SCREEN_WIDTH;
-}
-
-#define card_draw_set_offset(x, y) { \
-    uint16_t offset = x + y * 40; \
-    card_draw_screenpos = &get_screen_mem()->mem[offset]; \
-    card_draw_colorpos = &COLOR_RAM[offset]; \
-}
-
-#if !USE_ASM
-static void draw_card_top(card_t card)
-{
-    card_draw_screenpos[0] = CARD_IDX_TOP_LEFT(card_number(card));
-    card_draw_screenpos[1] = CARD_IDX(TOP);
-    card_draw_screenpos[2] = CARD_IDX(TOP);
-    card_draw_screenpos[3] = CARD_IDX(TOP_RIGHT);
-}
-#else
-extern void fastcall asm_draw_card_top(card_t card);
-#define draw_card_top(card) asm_draw_card_top(card)
-#endif
-
-/* Draw the left, two middle spaces, and right */
-#if !USE_ASM
-static void draw_card_middle(void)
-{
-    card_draw_screenpos[0] = CARD_IDX(LEFT);
-    card_draw_screenpos[1] = ' ';
-    card_draw_screenpos[2] = ' ';
-    card_draw_screenpos[3] = CARD_IDX(RIGHT);
-}
-#else
-extern void fastcall asm_draw_card_middle(void);
-#define draw_card_middle() asm_draw_card_middle()
-#endif
-
-#if !USE_ASM
-static void draw_card_bottom(card_t card)
-{
-    card_draw_screenpos[0] = CARD_IDX(BOTTOM_LEFT);
-    card_draw_screenpos[1] = CARD_IDX(BOTTOM);
-    card_draw_screenpos[2] = CARD_IDX(BOTTOM);
-    card_draw_screenpos[3] = CARD_IDX_BOTTOM_RIGHT(card_number(card));
-}
-#else
-extern void fastcall asm_draw_card_bottom(card_t card);
-#define draw_card_bottom(card) asm_draw_card_bottom(card)
-#endif
-
-static void draw_bg()
-{
-    card_draw_screenpos[0] = BG_CHAR;
-    card_draw_screenpos[1] = BG_CHAR;
-    card_draw_screenpos[2] = BG_CHAR;
-    card_draw_screenpos[3] = BG_CHAR;
-}
-
-static void draw_card(uint8_t x, uint8_t y, card_t card)
-{
-    char *char_addr = &get_screen_mem()->mem[0];
-    int i;
-
-    card_draw_set_offset(x, y);
-
-    if (card == 0) {
-        for (i = 0; i < CARD_HEIGHT; i++) {
-            set_card_row_color(COLOR_GREEN);
-            draw_bg();
-            card_draw_line_advance();
-        }
-        return;
-    }
-
-    draw_card_top(card);
-    set_card_row_color(card_color(card));
-    card_draw_line_advance();
-
-
-    for (i = 0; i < CARD_HEIGHT - 2; i++) {
-        draw_card_middle();
-        set_card_row_color(card_color(card));
-        card_draw_line_advance();
-    }
-
-    draw_card_bottom(card);
-    set_card_row_color(card_color(card));
-}
-
-static void move_done_stack(uint8_t done, uint8_t card)
-{
-    uint8_t x = (done+4) * (CARD_WIDTH+1);
-    done_stack[done] = card;
-    draw_card(x, 1, card);
-}
-
-static void draw_cell(uint8_t cell)
-{
-    uint8_t x = cell * (CARD_WIDTH+1);
-    draw_card(x, 1, freecells[cell]);
-}
-
-static void draw_stack(uint8_t stack)
-{
-    register uint8_t row;
-    register card_t *stack_cards;
-    register card_t card;
-    register uint8_t color;
-    register uint8_t body = 0;
-    static uint8_t body_count; // Not reentrant
-
-    if (stack > NUM_STACKS) {
-        draw_cell(stack - NUM_STACKS);
-        return;
-    }
-
-    stack_cards = stacks[stack];
-    card_draw_set_offset(stack * (CARD_WIDTH + 1), LOWER_STACKS_Y);
-
-    for (row = 0; row < STACK_MAX_ROWS; row++) {
-        card = row < STACK_MAX_CARDS ? stack_cards[row] : 0;
-
-        if (card) {
-            draw_card_top(card);
-            color = card_color(card);
-            set_card_row_color(color);
-            body = card;
-            body_count = 0;
-        } else if (body) {
-            set_card_row_color(color);
-            if (body_count < CARD_HEIGHT - 2) {
-                draw_card_middle();
-                body_count++;
-            } else {
-                draw_card_bottom(body);
-                body = 0;
-            }
-        } else {
-            // Background
-            set_card_row_color(COLOR_GREEN);
-            draw_bg();
-        }
-
-        card_draw_line_advance();
-    }
-}
-
-static void check_moves(void);
-
-#define DECK_SIZE 38
-
-#define rand() (SID.noise)
-
-static void cards(void)
-{
-    int i;
-    int j = 0;
-    static uint8_t deck[DECK_SIZE];
-    uint8_t rnd1, rnd2, tmp;
-
-    for (i=0; i<11; i++) {
-        deck[j++] = make_card(i+1, RED);
-    }
-    for (i=0; i<11; i++) {
-        deck[j++] = make_card(i+1, GREEN);
-    }
-    /* No black flower */
-    for (i=0; i<10; i++) {
-        deck[j++] = make_card(i+1, BLACK);
-    }
-
-    /* There are actually 3 each of the dragons, so throw in the extras */
-    deck[j++] = make_card(CARD_DRAGON, RED);
-    deck[j++] = make_card(CARD_DRAGON, RED);
-    deck[j++] = make_card(CARD_DRAGON, GREEN);
-    deck[j++] = make_card(CARD_DRAGON, GREEN);
-    deck[j++] = make_card(CARD_DRAGON, BLACK);
-    deck[j++] = make_card(CARD_DRAGON, BLACK);
-    
-    /* Setup RNG */
-    SID.v3.freq = 0xffff;
-    /* Noise waveform, output disabled */
-    SID.v3.ctrl = 0x80;
-
-    /* Perform 100 swaps */
-    for (i=0; i<100; i++) {
-        rnd1 = rand() % DECK_SIZE;
-        rnd2 = rand() % DECK_SIZE;
-
-        tmp = deck[rnd1];
-        deck[rnd1] = deck[rnd2];
-        deck[rnd2] = tmp;
-    }
-
-    /* Deal them out */
-    j=0;
-    for(i = 0; i<NUM_STACKS; i++) {
-        stacks[i][0] = deck[j++];
-        draw_stack(i);
-    }
-    for(i = 0; i<NUM_STACKS; i++) {
-        stacks[i][1] = deck[j++];
-        draw_stack(i);
-    }
-    for(i = 0; i<NUM_STACKS; i++) {
-        stacks[i][2] = deck[j++];
-        draw_stack(i);
-    }
-    for(i = 0; i<NUM_STACKS; i++) {
-        stacks[i][3] = deck[j++];
-        draw_stack(i);
-    }
-    for(i = 0; i<6; i++) {
-        stacks[i][4] = deck[j++];
-        draw_stack(i);
-    }
-
-    check_moves();
-}
-
-#define RASTER_MIN      51
-#define RASTER_MAX      (RASTER_MIN + SCREEN_HEIGHT * 8)
+#include "draw.h"
+#include "seeds.h"
+#include "prof.h"
+#include "mux.h"
+#include "disk.h"
+#include "mouse.h"
+#include "replay.h"
+
+/* Cursor position. Owned by the raster interrupt, see frame_irq() */
+static volatile uint16_t posx;
+static volatile uint8_t posy;
+/* Number of cards in held_run[] held by the cursor. 0 if none */
+static volatile uint8_t held_count;
 
 #define SPRITE_XOFFSET  24
 #define SPRITE_YOFFSET  (29 + 21)
@@ -315,18 +31,22 @@ static void cards(void)
 #define SPRITE_YMIN (SPRITE_YOFFSET)
 #define SPRITE_YMAX (SPRITE_YOFFSET + (SCREEN_HEIGHT * 8) - 2) /* Leave a couple extra pixels so it's still visible */
 
-#define SPRITE_ID_CARD_BG       7
-#define SPRITE_ID_CARD_TOP      6
-#define SPRITE_ID_CARD_BOTTOM   5
 #define SPRITE_ID_MOUSE         0
 
-#define SPRITE_CARD_MASK    ((1 << SPRITE_ID_CARD_BG) | \
-                             (1 << SPRITE_ID_CARD_TOP) | \
-                             (1 << SPRITE_ID_CARD_BOTTOM))
+/*
+ * Held cards are multiplexed, see mux.h. Lower numbered sprites are in
+ * front: the card faces (labels, top and bottom) are on 1-4, and the white
+ * backgrounds behind them on 5-7.
+ */
+#define SPRITE_POOL_FACE    0x1e
+#define SPRITE_POOL_BG      0xe0
+
+#define SPRITE_CARD_MASK    (SPRITE_POOL_FACE | SPRITE_POOL_BG)
 #define SPRITE_MOUSE_MASK   (1 << SPRITE_ID_MOUSE)
 
-#define show_card_sprites() { VIC.spr_ena |= SPRITE_CARD_MASK; }
-#define hide_card_sprites() { VIC.spr_ena &= ~SPRITE_CARD_MASK; }
+/* Only the foreground touches spr_ena; positions are written by frame_irq() */
+#define show_card_sprites() { VIC.spr_ena |= mux_sprites; }
+#define hide_card_sprites() { VIC.spr_ena &= ~SPRITE_CARD_MASK; mux_clear(); }
 
 /*
  * 3 sprites to draw the card.
@@ -334,9 +54,15 @@ static void cards(void)
  * top: 24x21
  * bot: 24x13
  * bg:  24x17 (y doubled) 24x34
+ * Cards above it in a run only show their top row, as a label: the top 8
+ * lines of the top sprite. Each card number has its own top, bottom and
+ * label frame, made by images/assets.py, so a card is just sprite pointers.
  */
 #define SPRITE_CARD_WIDTH_PX    (24)
 #define SPRITE_CARD_HEIGHT_PX   (34)
+#define SPRITE_TOP_HEIGHT_PX    (21)
+/* Lines between the tops of cards in a run, as in a stack */
+#define SPRITE_RUN_STEP_PX      (8)
 
 #define JOY_UP      (1 << 0)
 #define JOY_DOWN    (1 << 1)
@@ -344,410 +70,341 @@ static void cards(void)
 #define JOY_RIGHT   (1 << 3)
 #define JOY_BTN     (1 << 4)
 
-#define JOY_SPEED 4
+#define JOY_MOVE    (JOY_UP | JOY_DOWN | JOY_LEFT | JOY_RIGHT)
+
+/*
+ * Joystick speed in pixels a frame. It starts slow for placing the cursor
+ * and goes up by one every JOY_ACCEL_FRAMES it's held, up to the most.
+ */
+#define JOY_SPEED_MIN       2
+#define JOY_SPEED_MAX       12
+#define JOY_ACCEL_FRAMES    2
+static uint8_t joy_held_frames;
 
 /* Debounced button state. */
 static bool button_state;
 static uint8_t button_state_frames = 255;
 #define button_changed()    (button_state_frames == 2) /* 2 frame debounce interval */
 
-static void drop_card_internal(uint8_t stack, uint8_t held_card);
-
-static void drop_card_cell(uint8_t stack, uint8_t held_card)
-{
-    uint8_t cell = stack - NUM_STACKS;
+/*
+ * Debounced button edge latched by frame_irq() for joy2_process(), with
+ * the stack or cell and the row under the cursor then, so the move doesn't
+ * depend on how soon the foreground gets to it
+ */
+#define BUTTON_PRESSED  1
+#define BUTTON_RELEASED 2
+static volatile uint8_t button_event;
+static volatile uint8_t button_stack;
+static volatile uint8_t button_row;
 
-    if (cell > NUM_CELLS-1)
-        cell = NUM_CELLS-1;
+/* Incremented by frame_irq() once per frame, at RASTER_MAX */
+static volatile uint8_t frame_count;
 
-    if (freecells[cell]) {
-        /* Stack already occupied */
-        drop_card_internal(held_card_src_col, held_card);
-    } else {
-        freecells[cell] = held_card;
-        draw_cell(cell);
-    }
+/* Where frame_irq() puts the card sprites when no card is held */
+static volatile uint16_t card_sprite_x;
+static volatile uint8_t card_sprite_y;
 
-    held_card = 0;
-}
+/* C stack for frame_irq(), see set_irq() */
+#define IRQ_STACK_SIZE  128
+static uint8_t irq_stack[IRQ_STACK_SIZE];
 
-static void drop_card_internal(uint8_t stack, uint8_t held_card)
+static void wait_frame(void)
 {
-    int i;
+    static uint8_t last_frame;
+    uint8_t frame = frame_count;
 
-    if (stack >= NUM_STACKS) {
-        drop_card_cell(stack, held_card);
-        return;
-    }
-
-    for (i=0; i<STACK_MAX_CARDS; i++) {
-        if (stacks[stack][i] == 0) {
-            stacks[stack][i] = held_card;
-            draw_stack(stack);
-            break;
-        }
-    }
+    /* Any frame IRQ since we last got here means the work overran */
+    PROF_OVERRUN((uint8_t)(frame - last_frame));
 
-    if (i==STACK_MAX_CARDS) {
-        drop_card_internal(held_card_src_col, held_card);
-    }
-
-    held_card = 0;
+    while (frame_count == frame);
+    last_frame = frame_count;
+    screen_present();
 }
 
-static void drop_card(uint8_t stack, uint8_t held_card)
+/* Position the card sprites from the foreground */
+static void set_card_sprite_pos(uint16_t x, uint8_t y)
 {
-    int j;
-    card_t top_card;
-
-    if (stack < NUM_STACKS) {
-        for (j=STACK_MAX_CARDS-1; j>=0; j--) {
-            if (stacks[stack][j])
-                break;
-        }
-
-        if (j < 0) {
-            /* Can always move onto an empty stack */
-            drop_card_internal(stack, held_card);
-            return;
-        } else {
-            /* Can't move a dragon from stack to stack */
-            if (card_number(held_card) == CARD_DRAGON) {
-                drop_card_internal(held_card_src_col, held_card);
-                return;
-            }
-
-            top_card = stacks[stack][j];
-
-            /* Can only stack cards by descending number */
-            if (card_number(held_card) != card_number(top_card)-1) {
-                drop_card_internal(held_card_src_col, held_card);
-                return;
-            }
-
-            /* Can't stack cards of the same color */
-            if (card_color(held_card) == card_color(top_card)) {
-                drop_card_internal(held_card_src_col, held_card);
-                return;
-            }
-        }
-    }
-
-    drop_card_internal(stack, held_card);
+    SEI();
+    card_sprite_x = x;
+    card_sprite_y = y;
+    CLI();
 }
 
-#define x_to_stack(x) (((x)/8/(CARD_WIDTH+1)) > NUM_STACKS-1 ? NUM_STACKS-1 : ((x)/8/(CARD_WIDTH+1)))
 #define stack_to_x(stack) ((uint16_t)(stack)*8*(CARD_WIDTH+1) + SPRITE_CARD_WIDTH_PX)
 #define row_to_y(row) ((row)*8 + LOWER_STACKS_Y*8 + SPRITE_CARD_HEIGHT_PX*2)
 
-static uint8_t pos_to_stack()
+/*
+ * Stack under each screen column, the gap right of a stack counting as
+ * that stack, so the hit test is a shift and a lookup. The row needs no
+ * table: every card but the top one shows just its own row, and take_run()
+ * gives any row past the top card to the top card. Keep in sync with
+ * CARD_WIDTH.
+ */
+#define STACK_COLUMNS(stack) stack, stack, stack, stack, stack
+static const uint8_t column_stack[SCREEN_WIDTH] = {
+    STACK_COLUMNS(0), STACK_COLUMNS(1), STACK_COLUMNS(2), STACK_COLUMNS(3),
+    STACK_COLUMNS(4), STACK_COLUMNS(5), STACK_COLUMNS(6), STACK_COLUMNS(7),
+};
+
+/* Latch what's under the cursor, from frame_irq() */
+static void button_hit(void)
 {
-    uint8_t stack = x_to_stack(posx - SPRITE_XOFFSET);
-    if (posy - SPRITE_YOFFSET < LOWER_STACKS_Y*8) {
+    uint8_t row = (uint8_t)(posy - SPRITE_YOFFSET) >> 3;
+
+    button_stack = column_stack[(uint8_t)((posx - SPRITE_XOFFSET) >> 3)];
+    if (row < LOWER_STACKS_Y) {
         /* Cursor is in the free cell area */
-        stack += NUM_STACKS;
+        button_stack += NUM_STACKS;
     }
-    return stack;
+    /* Card in a lower stack, 0 at the bottom of the stack */
+    button_row = row - LOWER_STACKS_Y;
 }
 
-static card_t take_card_cell(uint8_t stack)
-{
-    uint8_t cell = stack - NUM_STACKS;
-    uint8_t card;
-
-    if (cell > NUM_CELLS-1)
-        cell = NUM_CELLS-1;
+static void sprite_run_personify(const card_t *run, uint8_t count);
+static void flights_process(void);
+static void flight_skip(void);
 
-    card = freecells[cell];
-    freecells[cell] = 0;
-    draw_cell(cell);
-    return card;
-}
+/* Pixels per frame, along the longer axis */
+#define ANIMATION_SPEED 4
+/* Frames each card takes to fly when finish_game() clears the table */
+#define FINISH_FLIGHT_FRAMES 2
 
-static card_t take_card()
+uint8_t hal_rand(void)
 {
-    uint8_t stack = pos_to_stack();
-    card_t card = 0;
-    int i;
-
-    if (stack >= NUM_STACKS) {
-        return take_card_cell(stack);
-    }
-
-    for (i=0; i<STACK_MAX_CARDS; i++) {
-        if (stacks[stack][i] == 0) {
-            break;
-        }
-        card = stacks[stack][i];
-    }
-
-    if (card) {
-        stacks[stack][i-1] = 0;
-        held_card_src_col = stack;
-        draw_stack(stack);
-    }
-
-    return card;
+    return REPLAY_RAND(SID.noise);
 }
 
-static int color_to_stack(uint8_t card) {
-    switch (card_color(card)) {
-        case COLOR_RED:
-            return 0;
-        case COLOR_GREEN:
-            return 1;
-        case COLOR_BLACK:
-            return 2;
-    }
-}
-
-static void animate_movement(card_t card, uint8_t src_stack, uint8_t row, uint8_t dest);
+/*
+ * Cards queued by animate_movement() to fly to the done piles. The first
+ * is the one in the air, if flying is set.
+ */
+#define FLIGHT_QUEUE_SIZE   8
+struct flight {
+    card_t card;
+    uint16_t src_x;
+    uint8_t src_y;
+    uint8_t dest;
+    card_t lands_as;    /* What the done pile shows once it gets there */
+    bool fast;          /* Queued by finish_game() */
+};
+static struct flight flights[FLIGHT_QUEUE_SIZE];
+static uint8_t flight_first;
+static uint8_t flight_count;
+static bool flying;
+static bool flight_shown;
+/* Set while finish_game() queues its cards */
+static bool finishing;
 
-static void remove_free_cards(card_t card)
+/*
+ * The card in the air, moved by frame_irq() in a straight line. Positions
+ * are 12.4 fixed point. flight_frames counts down to 0 when it lands.
+ */
+#define FLIGHT_FRAC_BITS    4
+#define FLIGHT_ONE          (1 << FLIGHT_FRAC_BITS)
+static volatile uint8_t flight_frames;
+static uint16_t flight_x;
+static uint16_t flight_y;
+static int16_t flight_step_x;
+static int16_t flight_step_y;
+static uint16_t flight_dest_x;
+static uint8_t flight_dest_y;
+
+void animate_movement(card_t card, uint8_t src_stack, uint8_t row, uint8_t dest)
 {
-    int i, j;
-
-    for (i=0; i<NUM_STACKS; i++) {
-        for (j=STACK_MAX_CARDS-1; j>=0; j--) {
-            if (stacks[i][j])
-                break;
-        }
-
-        /* Check if stack is empty */
-        if (j<0)
+    struct flight *f;
+
+    /*
+     * Let the ones in the air land to make room. Finishing doesn't wait, so
+     * the first ones land straight away and only the last few fly.
+     */
+    while (flight_count == FLIGHT_QUEUE_SIZE) {
+        if (finishing) {
+            flight_skip();
             continue;
-
-        if (stacks[i][j] == card) {
-            stacks[i][j] = 0;
-            draw_stack(i);
-            animate_movement(card, i, j, 3);
-            move_done_stack(3, make_card(CARD_BACK, BLACK));
         }
+        wait_frame();
+        flights_process();
     }
 
-    for (i=0; i<NUM_CELLS; i++) {
-        if (freecells[i] == card) {
-            freecells[i] = 0;
-            draw_cell(i);
-            animate_movement(card, i, 0, 3);
-            move_done_stack(3, make_card(CARD_BACK, BLACK));
-        }
+    f = &flights[(flight_first + flight_count) % FLIGHT_QUEUE_SIZE];
+    f->card = card;
+    if (src_stack < NUM_STACKS) {
+        f->src_x = stack_to_x(src_stack);
+        f->src_y = row_to_y(row);
+    } else {
+        f->src_x = stack_to_x(src_stack - NUM_STACKS);
+        f->src_y = 0;
     }
+    f->dest = dest;
+    f->lands_as = done_stack[dest];
+    f->fast = finishing;
+    flight_count++;
 }
 
-static void sprite_card_personify(card_t card);
-static void move_card_sprite(uint16_t x, uint8_t y);
-
-/* Pixels per frame */
-#define ANIMATION_SPEED 4
-
-static void animate_movement(card_t card, uint8_t src_stack, uint8_t row, uint8_t dest)
+static void flight_start(void)
 {
-    uint16_t src_x;
-    uint8_t src_y;
-    uint16_t dest_x = stack_to_x(dest+4);
+    struct flight *f = &flights[flight_first];
+    uint16_t dest_x = stack_to_x(f->dest+4);
     const uint8_t dest_y = SPRITE_CARD_HEIGHT_PX*2;
-    int8_t dir_x;
-    int8_t dir_y;
-
-    if (src_stack < NUM_STACKS) {
-        src_x = stack_to_x(src_stack);
-        src_y = row_to_y(row);
-    } else {
-        src_x = stack_to_x(src_stack - NUM_STACKS);
-        src_y = 0;
-    }
+    int16_t dx = dest_x - f->src_x;
+    int16_t dy = dest_y - f->src_y;
+    uint16_t dist;
+    uint8_t frames;
 
-    if (src_x < dest_x) {
-        dir_x = 1;
+    if (f->fast) {
+        frames = FINISH_FLIGHT_FRAMES;
     } else {
-        dir_x = -1;
-    }
-
-    if (src_y < dest_y) {
-        dir_y = 1;
-    } else {
-        dir_y = -1;
-    }
-
-    sprite_card_personify(card);
-    show_card_sprites();
-
-    while (src_x != dest_x || src_y != dest_y) {
-        while (VIC.rasterline < RASTER_MAX);
-
-        move_card_sprite(src_x, src_y);
-        if (src_x != dest_x) {
-            if (abs(src_x-dest_x) < ANIMATION_SPEED)
-                src_x = dest_x;
-            else
-                src_x += dir_x*ANIMATION_SPEED;
-        }
-        if (src_y != dest_y) {
-            if (abs(src_y-dest_y) < ANIMATION_SPEED)
-                src_y = dest_y;
-            else
-                src_y += dir_y*ANIMATION_SPEED;
-        }
+        /* Frames for the longer axis at ANIMATION_SPEED, at least one */
+        dist = abs(dx) > abs(dy) ? abs(dx) : abs(dy);
+        frames = (dist + ANIMATION_SPEED - 1) / ANIMATION_SPEED;
+        if (!frames)
+            frames = 1;
+    }
+
+    sprite_run_personify(&f->card, 1);
+    set_card_sprite_pos(f->src_x, f->src_y);
+
+    SEI();
+    flight_x = f->src_x * FLIGHT_ONE;
+    flight_y = f->src_y * FLIGHT_ONE;
+    flight_step_x = dx * FLIGHT_ONE / frames;
+    flight_step_y = dy * FLIGHT_ONE / frames;
+    flight_dest_x = dest_x;
+    flight_dest_y = dest_y;
+    flight_frames = frames;
+    CLI();
+
+    flying = true;
+    /* Shown once frame_irq() has moved the sprites there */
+    flight_shown = false;
+}
 
-        while (VIC.rasterline >= RASTER_MAX);
-    }
+static void flight_land(void)
+{
+    struct flight *f = &flights[flight_first];
 
     hide_card_sprites();
+    draw_done_card(f->dest, f->lands_as);
+    flight_first = (flight_first + 1) % FLIGHT_QUEUE_SIZE;
+    flight_count--;
+    flying = false;
 }
 
-/* Look for any flowers or cards that can move to done */
-static void check_moves(void)
+/*
+ * Called every frame: show the card taking off, draw the done pile under
+ * one that landed and start the next. Nothing flies while cards are held.
+ */
+static void flights_process(void)
 {
-    int i, j;
-    card_t card;
-    bool redraw;
-    bool rerun;
-    int stack;
-    bool found_card;
-    uint8_t free_dragons[3];
-
-again:
-    free_dragons[0] = 0;
-    free_dragons[1] = 0;
-    free_dragons[2] = 0;
-    rerun = false;
-    found_card = false;
-    for (i=0; i<NUM_STACKS; i++) {
-        redraw = false;
-
-        for (j=STACK_MAX_CARDS-1; j>=0; j--) {
-            if (stacks[i][j])
-                break;
-        }
-
-        /* Check if stack is empty */
-        if (j<0)
-            continue;
-
-        found_card = true;
-        card = stacks[i][j];
-        if (card_number(card) == CARD_FLOWER) {
-            stacks[i][j] = 0;
-            draw_stack(i);
-            animate_movement(card, i, j, 3);
-            move_done_stack(3, make_card(CARD_BACK, BLACK));
-            redraw = true;
-        } else {
-            stack = color_to_stack(card);
-            if (card_number(card) == CARD_DRAGON) {
-                free_dragons[stack]++;
-            } else if (card_number(card) == card_number(done_stack[stack])+1) {
-                stacks[i][j] = 0;
-                draw_stack(i);
-                animate_movement(card, i, j, stack);
-                move_done_stack(stack, card);
-                redraw = true;
-            }
-        }
-
-        if (redraw) {
-            draw_stack(i);
-            rerun = true;
-        }
+    if (flying && !flight_frames) {
+        flight_land();
     }
-
-    for (i=0; i<NUM_CELLS; i++) {
-        if (freecells[i] == 0)
-            continue;
-
-        found_card = true;
-        card = freecells[i];
-        stack = color_to_stack(card);
-        if (card_number(card) == CARD_DRAGON)
-            free_dragons[stack]++;
-        if (card_number(card) == card_number(done_stack[stack])+1) {
-            freecells[i] = 0;
-            draw_cell(i);
-            animate_movement(card, NUM_STACKS+i, 0, stack);
-            move_done_stack(stack, card);
-            rerun = true;
-        }
+    if (flying && !flight_shown) {
+        show_card_sprites();
+        flight_shown = true;
     }
-
-    for (i=0; i<3; i++) {
-        card = done_stack[i];
-        stack = color_to_stack(card);
-        if (card_number(card) == CARD_DRAGON)
-            free_dragons[stack]++;
-    }
-
-    if (free_dragons[0] == 3) {
-        remove_free_cards(make_card(CARD_DRAGON, RED));
-        rerun = true;
-    }
-    if (free_dragons[1] == 3) {
-        remove_free_cards(make_card(CARD_DRAGON, GREEN));
-        rerun = true;
-    }
-    if (free_dragons[2] == 3) {
-        remove_free_cards(make_card(CARD_DRAGON, BLACK));
-        rerun = true;
+    if (!flying && flight_count && !held_count) {
+        flight_start();
     }
+}
 
-    if (!found_card) {
-        game_over = true;
+/* Land the first card still to fly at once */
+static void flight_skip(void)
+{
+    if (flying) {
+        SEI();
+        flight_frames = 0;
+        CLI();
+        flight_land();
         return;
     }
+    draw_done_card(flights[flight_first].dest, flights[flight_first].lands_as);
+    flight_first = (flight_first + 1) % FLIGHT_QUEUE_SIZE;
+    flight_count--;
+}
 
-    if (rerun)
-        goto again;
+/* Land every card still to fly at once */
+static void flights_finish(void)
+{
+    while (flight_count)
+        flight_skip();
 }
 
 /*
- * Copy a character (8x8) bitmap to an 8x8 location in a sprite of width 24.
- * Must be byte aligned.
+ * Set up the multiplexer shape for count cards, top first. Each gets a
+ * label but the last, which is drawn whole. A background goes behind the
+ * first card and then behind each card the one before doesn't reach, the
+ * last flush with the bottom of the run. Only called with the card sprites
+ * hidden.
  */
-static void copy_char_to_sprite(uint8_t *c, uint8_t *sprite)
+static void sprite_run_personify(const card_t *run, uint8_t count)
 {
-    int i;
+    uint8_t i;
+    uint8_t dy;
+    uint8_t bg_end = 0;
+    card_t card;
 
-    for (i = 0; i < 8; i++) {
-        *sprite = c[i];
-        sprite += 3;
-    }
-}
+    PROF_ENTER(PROF_PERSONIFY);
+    mux_clear();
+    for (i = 0, dy = 0; i < count; i++, dy += SPRITE_RUN_STEP_PX) {
+        card = run[i];
 
-static void sprite_card_personify(card_t card)
-{
-    copy_char_to_sprite(CARD_TOP_LEFT + (card_number(card)-1) * 8, SPRITE_CARD_TOP);
-    /* Bottom right is row 26, col 2 */
-    copy_char_to_sprite(CARD_BOTTOM_RIGHT + (card_number(card)-1) * 8, SPRITE_CARD_BOTTOM + (26 - 21) * 3 + 2);
-    VIC.spr_color[SPRITE_ID_CARD_TOP] = card_color(card);
-    VIC.spr_color[SPRITE_ID_CARD_BOTTOM] = card_color(card);
-}
+        if (dy + SPRITE_RUN_STEP_PX > bg_end ||
+            (i == count-1 && dy + SPRITE_CARD_HEIGHT_PX > bg_end)) {
+            mux_add(dy, SPRITE_POOL_BG, (uint8_t)&SPRITE_PTR_CARD_BG, COLOR_WHITE);
+            bg_end = dy + SPRITE_CARD_HEIGHT_PX;
+        }
 
-static void move_card_sprite(uint16_t x, uint8_t y)
-{
-    VIC.spr_pos[SPRITE_ID_CARD_BG].x = (uint8_t)x;
-    VIC.spr_pos[SPRITE_ID_CARD_TOP].x = (uint8_t)x;
-    VIC.spr_pos[SPRITE_ID_CARD_BOTTOM].x = (uint8_t)x;
+        if (i < count-1) {
+            mux_add(dy, SPRITE_POOL_FACE, CARD_FRAME(LABELS, card_number(card)), card_color(card));
+            continue;
+        }
 
-    if (x >> 8) {
-        VIC.spr_hi_x |= SPRITE_CARD_MASK;
-    } else {
-        VIC.spr_hi_x &= ~SPRITE_CARD_MASK;
+        mux_add(dy, SPRITE_POOL_FACE, CARD_FRAME(TOPS, card_number(card)), card_color(card));
+        mux_add(dy + SPRITE_TOP_HEIGHT_PX, SPRITE_POOL_FACE, CARD_FRAME(BOTTOMS, card_number(card)), card_color(card));
     }
-
-    VIC.spr_pos[SPRITE_ID_CARD_BG].y = (uint8_t)y;
-    VIC.spr_pos[SPRITE_ID_CARD_TOP].y = (uint8_t)y;
-    VIC.spr_pos[SPRITE_ID_CARD_BOTTOM].y = (uint8_t)(y + 21);
+    PROF_EXIT(PROF_PERSONIFY);
 }
 
-static void joy2_process(void)
+/*
+ * Raster interrupt at RASTER_MAX, i.e. the top of the lower border.
+ * Samples the joystick and mouse, moves the cursor and updates every
+ * sprite position at the same point in each frame, independent of what the
+ * foreground is doing. Sprites reused further down the screen are moved by muxirq.s,
+ * which handles its own raster interrupts. Runs on its own C stack via
+ * set_irq(), so it must not call any of the drawing code (which keeps its
+ * state in globals).
+ */
+static uint8_t frame_irq(void)
 {
-    uint16_t card_posx;
-    uint8_t card_posy;
-    uint8_t joyval = ~CIA1.pra;
-    uint8_t stack;
+    uint8_t joyval;
+    uint8_t keys;
+    uint8_t port1;
+    uint8_t speed;
+    int16_t x;
+    int16_t y;
+    uint8_t hi_x;
     bool cur_button_state;
 
-    VIC.bordercolor = COLOR_BLUE;
+    if (!(VIC.irr & VIC_IRQ_RASTER)) {
+        return IRQ_NOT_HANDLED;
+    }
+    VIC.irr = VIC_IRQ_RASTER;
+    PROF_ENTER(PROF_FRAME_IRQ);
+
+    joyval = ~CIA1.pra;
+    mouse_frame();
+    /*
+     * Either port's fire is the button. Port 1 shares its lines with the
+     * keyboard rows, so deselect the column the KERNAL's scan left
+     * selected, or SPACE reads as fire.
+     */
+    keys = CIA1.pra;
+    CIA1.pra = 0xff;
+    port1 = ~CIA1.prb;
+    CIA1.pra = keys;
+    joyval = (joyval & JOY_MOVE) | ((joyval | port1) & JOY_BTN);
+    REPLAY_INPUT(joyval);
 
     /* Handle button debounce */
     cur_button_state = !!(joyval & JOY_BTN);
@@ -760,102 +417,318 @@ static void joy2_process(void)
     }
     button_state = cur_button_state;
 
-
     if (button_changed()) {
-        if (button_state) {
-            held_card = take_card();
-            if (held_card) {
-                sprite_card_personify(held_card);
-                show_card_sprites();
-            }
-        } else {
-            hide_card_sprites();
-            if (held_card) {
-                stack = pos_to_stack();
-                drop_card(stack, held_card);
-                check_moves();
-            }
-        }
+        button_event = button_state ? BUTTON_PRESSED : BUTTON_RELEASED;
+        button_hit();
     }
 
+    if (!(joyval & JOY_MOVE)) {
+        joy_held_frames = 0;
+    } else if (joy_held_frames < (JOY_SPEED_MAX - JOY_SPEED_MIN) * JOY_ACCEL_FRAMES) {
+        joy_held_frames++;
+    }
+    speed = JOY_SPEED_MIN + joy_held_frames / JOY_ACCEL_FRAMES;
+
+    /* Signed and wide, as the mouse and a fast joystick can pass an edge */
+    x = posx + mouse_dx;
+    y = posy - mouse_dy;
     if (joyval & JOY_UP) {
-        posy -= JOY_SPEED;
+        y -= speed;
     }
     if (joyval & JOY_DOWN) {
-        posy += JOY_SPEED;
+        y += speed;
     }
-    if (posy > SPRITE_YMAX) {
-        posy = SPRITE_YMAX;
+    if (y > SPRITE_YMAX) {
+        y = SPRITE_YMAX;
     }
-    if (posy < SPRITE_YMIN) {
-        posy = SPRITE_YMIN;
+    if (y < SPRITE_YMIN) {
+        y = SPRITE_YMIN;
     }
     if (joyval & JOY_LEFT) {
-        posx -= JOY_SPEED;
+        x -= speed;
     }
     if (joyval & JOY_RIGHT) {
-        posx += JOY_SPEED;
-    }
-    if (posx > SPRITE_XMAX) {
-        posx = SPRITE_XMAX;
-    }
-    if (posx < SPRITE_XMIN) {
-        posx = SPRITE_XMIN;
+        x += speed;
+    }
+    if (x > SPRITE_XMAX) {
+        x = SPRITE_XMAX;
+    }
+    if (x < SPRITE_XMIN) {
+        x = SPRITE_XMIN;
+    }
+    posx = x;
+    posy = y;
+
+    if (held_count) {
+        card_sprite_x = posx - (SPRITE_CARD_WIDTH_PX / 2);
+        card_sprite_y = posy - (SPRITE_CARD_HEIGHT_PX / 2);
+    } else if (flight_frames) {
+        if (--flight_frames) {
+            flight_x += flight_step_x;
+            flight_y += flight_step_y;
+            card_sprite_x = flight_x >> FLIGHT_FRAC_BITS;
+            card_sprite_y = flight_y >> FLIGHT_FRAC_BITS;
+        } else {
+            card_sprite_x = flight_dest_x;
+            card_sprite_y = flight_dest_y;
+        }
     }
-    card_posx = posx - (SPRITE_CARD_WIDTH_PX / 2);
-    card_posy = posy - (SPRITE_CARD_HEIGHT_PX / 2);
-    move_card_sprite(card_posx, card_posy);
+    mux_frame(card_sprite_x, card_sprite_y);
 
+    hi_x = 0;
+    if (card_sprite_x >> 8) {
+        hi_x |= SPRITE_CARD_MASK;
+    }
     if (posx >> 8) {
-        VIC.spr_hi_x |= SPRITE_MOUSE_MASK;
-    } else {
-        VIC.spr_hi_x &= ~SPRITE_MOUSE_MASK;
+        hi_x |= SPRITE_MOUSE_MASK;
     }
+    VIC.spr_hi_x = hi_x;
 
     VIC.spr_pos[SPRITE_ID_MOUSE].x = (uint8_t)posx;
     VIC.spr_pos[SPRITE_ID_MOUSE].y = (uint8_t)posy;
+
+    frame_count++;
+    PROF_EXIT(PROF_FRAME_IRQ);
+    return IRQ_HANDLED;
+}
+
+/* Act on button presses latched by frame_irq() */
+static void joy2_process(void)
+{
+    uint8_t event;
+    uint8_t count;
+
+    VIC.bordercolor = COLOR_BLUE;
+    PROF_ENTER(PROF_JOY2);
+
+    SEI();
+    event = button_event;
+    button_event = 0;
+    CLI();
+
+    if (event == BUTTON_PRESSED) {
+        /* From the card under the cursor up, as far as it's a run */
+        count = take_run(button_stack, button_row);
+        if (count) {
+            /* The held cards need the sprites */
+            flights_finish();
+            sprite_run_personify(held_run, count);
+            held_count = count;
+            /* Let frame_irq() move the sprites under the cursor first */
+            wait_frame();
+            show_card_sprites();
+        }
+    } else if (event == BUTTON_RELEASED) {
+        hide_card_sprites();
+        if (held_count) {
+            count = held_count;
+            held_count = 0;
+            drop_run(button_stack, count);
+            if (finish_ready()) {
+                finishing = true;
+                finish_game();
+                finishing = false;
+            } else {
+                check_moves();
+            }
+        }
+    }
+
+    PROF_EXIT(PROF_JOY2);
     VIC.bordercolor = COLOR_RED;
 }
 
+/* Seed of the deal being played */
+static uint16_t deal_seed;
+
+static void new_game(uint16_t seed)
+{
+    deal_seed = seed;
+    cards(seed);
+    draw_seed(seed, 4);
+}
+
+/*
+ * N deals a new game, R restarts this one, and S followed by four letters
+ * A-P plays the deal with that seed (as shown by draw_seed()). Any other
+ * key while typing a seed cancels it. Z undoes a move and Y redoes it.
+ * F1 saves the game to disk and F3 puts the saved one back.
+ * Returns false when Q is pressed.
+ */
+static bool key_process(void)
+{
+    static bool entering;
+    static uint8_t digits;
+    static uint16_t entry;
+    static uint8_t saved[SAVE_MAX];
+    uint8_t len;
+    char key;
+
+    /* Keys wait in the buffer until every card has landed */
+    if (flight_count)
+        return true;
+
+    key = REPLAY_KEY(cbm_k_getin());
+    /* No new deals or undo while a card is picked up */
+    if (!key || held_count)
+        return true;
+
+    if (entering) {
+        if (key >= 'a' && key <= 'p') {
+            entry = (entry << 4) | (key - 'a');
+            digits++;
+            draw_seed(entry, digits);
+            if (digits == 4) {
+                entering = false;
+                new_game(entry);
+            }
+        } else {
+            entering = false;
+            draw_seed(deal_seed, 4);
+        }
+        return true;
+    }
+
+    switch (key) {
+        case 'q':
+            /* The cartridge starts over instead, see cart.s */
+            return false;
+        case 'n':
+            new_game(solvable_seeds[hal_rand()]);
+            break;
+        case 'r':
+            new_game(deal_seed);
+            break;
+        case 'z':
+            undo_move();
+            break;
+        case 'y':
+            redo_move();
+            break;
+        case 's':
+            entering = true;
+            digits = 0;
+            entry = 0;
+            draw_seed(0, 0);
+            break;
+        case CH_F1:
+            len = save_game(saved, deal_seed);
+            disk_save(saved, len);
+            break;
+        case CH_F3:
+            len = disk_restore(saved, sizeof(saved));
+            if (restore_game(saved, len, &deal_seed))
+                draw_seed(deal_seed, 4);
+            break;
+    }
+    return true;
+}
+
 static void sprite_setup(void)
 {
-    get_screen_mem()->sprite_ptr[SPRITE_ID_CARD_BG] = (uint8_t)&SPRITE_PTR_CARD_BG;
-    get_screen_mem()->sprite_ptr[SPRITE_ID_CARD_TOP] = (uint8_t)&SPRITE_PTR_CARD_TOP;
-    get_screen_mem()->sprite_ptr[SPRITE_ID_CARD_BOTTOM] = (uint8_t)&SPRITE_PTR_CARD_BOTTOM;
-    get_screen_mem()->sprite_ptr[SPRITE_ID_MOUSE] = (uint8_t)&SPRITE_PTR_MOUSE;
-    VIC.spr_exp_y = (1 << SPRITE_ID_CARD_BG);
-    VIC.spr_color[SPRITE_ID_CARD_BG] = COLOR_WHITE;
-    VIC.spr_color[SPRITE_ID_CARD_TOP] = COLOR_BLACK;
-    VIC.spr_color[SPRITE_ID_CARD_BOTTOM] = COLOR_BLACK;
+    /* Card sprite pointers and colors are set by mux_frame() */
+    set_sprite_ptr(SPRITE_ID_MOUSE, (uint8_t)&SPRITE_PTR_MOUSE);
+    VIC.spr_exp_y = SPRITE_POOL_BG;
     VIC.spr_color[SPRITE_ID_MOUSE] = COLOR_BLACK;
     VIC.spr_ena = SPRITE_MOUSE_MASK; // Enable mouse
-    joy2_process(); // Set up initial position
 }
 
+static void rng_setup(void)
+{
+    SID.v3.freq = 0xffff;
+    /* Noise waveform, output disabled */
+    SID.v3.ctrl = 0x80;
+}
+
+
+#if defined(BENCH) || defined(REPLAY)
+/* VICE -debugcart: writing here quits the emulator with that exit code */
+#define DEBUGCART_EXIT (*(volatile uint8_t *)0xd7ff)
+#endif
+
+#ifdef BENCH
+
+/* Every bench run plays the same deal */
+#define BENCH_SEED  1
+
+/*
+ * Run by the bench build ('make bench'). bench.py breaks on each of these
+ * routines through the monitor and counts the cycles until it returns.
+ */
+static void bench(void)
+{
+    uint8_t i;
+
+    cards(BENCH_SEED);
+
+    /* Full redraw of every stack */
+    for (i = 0; i < NUM_STACKS; i++) {
+        stack_dirty_first[i] = 0;
+        stack_dirty_last[i] = STACK_MAX_ROWS - 1;
+        draw_stack(i);
+    }
+
+    /* A run of three, which needs the multiplexer */
+    held_run[0] = make_card(CARD9, RED);
+    held_run[1] = make_card(CARD8, GREEN);
+    held_run[2] = make_card(CARD7, RED);
+    sprite_run_personify(held_run, 3);
+    check_moves();
+
+    wait_frame();
+    joy2_process();
+
+    DEBUGCART_EXIT = 0;
+}
+#endif
 
 int main(void)
 {
+#ifndef CART
+    /* printf() alone would take a good part of the cartridge */
     printf("hello world port: 0x%x\n", *(unsigned char *)(0x01));
     printf("screen at 0x%x\n", (uint16_t)get_screen_mem());
+#endif
 #if 1
+    PROF_INIT();
     sprite_setup();
+    rng_setup();
     copy_character_rom();
     set_screen_addr();
     init_screen();
-    cards();
+    /* frame_irq() sets up the initial cursor position on its first run */
+    mouse_init();
+    set_irq(frame_irq, irq_stack, IRQ_STACK_SIZE);
+    raster_irq_start(RASTER_MAX);
+#ifdef BENCH
+    bench();
+#endif
+    new_game(solvable_seeds[hal_rand()]);
 #endif
     //printf("Screenreg 0x %x\n", (char)&SCREENREG);
     //printf("Press return to exit");
-    while (cbm_k_getin() != 'q' && !game_over) {
-        while (VIC.rasterline < RASTER_MAX);
+    while (key_process() && !game_over && !REPLAY_DONE()) {
+        wait_frame();
 
+        /* The border now marks foreground time from a fixed raster line */
         VIC.bordercolor = COLOR_RED;
         joy2_process();
+        flights_process();
         VIC.bordercolor = COLOR_BLACK;
+    }
 
-        while (VIC.rasterline >= RASTER_MAX);
+    /* Let the last cards land */
+    while (flight_count) {
+        wait_frame();
+        flights_process();
     }
+    REPLAY_FINISH(deal_seed);
+#ifdef REPLAY
+    DEBUGCART_EXIT = 0;
+#endif
 
+    raster_irq_stop();
+    reset_irq();
     VIC.spr_ena = 0; // Hide sprites
     restore_screen_addr();
     /* Turn off Extended Background Color Mode */
@@ -0,0 +1,47 @@
+#include <stdint.h>
+
+#include <cbm.h>
+
+#include "mouse.h"
+
+/* Bits of a pot value the mouse sets; bit 0 is noise */
+#define POT_MASK    0x7e
+/* Set in a masked delta that's a move back */
+#define POT_BACK    0x40
+
+int8_t mouse_dx;
+int8_t mouse_dy;
+
+static uint8_t last_x;
+static uint8_t last_y;
+
+/*
+ * Signed counts from last to now. The KERNAL's keyboard scan selects other
+ * pots while it runs and leaves port 1's selected after, so a sample taken
+ * during a scan can be off, showing as a one frame jump.
+ */
+static int8_t pot_delta(uint8_t now, uint8_t last)
+{
+    uint8_t delta = ((now & POT_MASK) - (last & POT_MASK)) & POT_MASK;
+
+    if (delta & POT_BACK)
+        return (delta >> 1) | 0xc0;
+    return delta >> 1;
+}
+
+void mouse_init(void)
+{
+    last_x = SID.ad1;
+    last_y = SID.ad2;
+}
+
+void mouse_frame(void)
+{
+    uint8_t x = SID.ad1;
+    uint8_t y = SID.ad2;
+
+    mouse_dx = pot_delta(x, last_x);
+    mouse_dy = pot_delta(y, last_y);
+    last_x = x;
+    last_y = y;
+}
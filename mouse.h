@@ -0,0 +1,24 @@
+#ifndef _MOUSE_H_
+#define _MOUSE_H_
+
+#include <stdint.h>
+
+/*
+ * Commodore 1351 mouse in control port 1. It sets the SID's pot lines to
+ * its position, modulo 64 in bits 1-6, and the SID samples them every 512
+ * cycles. frame_irq() calls mouse_frame() once a frame, often enough that
+ * it never moves 32 counts between readings, and adds the deltas to the
+ * cursor. The left button is the port's fire line, read with the
+ * joystick's.
+ */
+
+/* Movement since the last mouse_frame(), right and up */
+extern int8_t mouse_dx;
+extern int8_t mouse_dy;
+
+/* Take the mouse's position as it is, so the first frame doesn't jump */
+void mouse_init(void);
+
+void mouse_frame(void);
+
+#endif
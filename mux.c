@@ -0,0 +1,121 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <cbm.h>
+
+#include "charset.h"
+#include "screen.h"
+#include "mux.h"
+
+/* Sprite Y for an instance below the screen, up in the top border */
+#define MUX_HIDDEN_Y    0
+
+/* Lines a sprite is shown for, twice that when y expanded */
+#define SPRITE_LINES    21
+
+/*
+ * The shape, top to bottom. shape_count goes up last, so frame_irq() only
+ * ever sees whole instances.
+ */
+static uint8_t shape_dy[MUX_MAX_SHAPE];
+static uint8_t shape_sprite[MUX_MAX_SHAPE];
+static uint8_t shape_ptr[MUX_MAX_SHAPE];
+static uint8_t shape_color[MUX_MAX_SHAPE];
+/* Whether the instance's sprite is also used further up */
+static bool shape_reuse[MUX_MAX_SHAPE];
+static uint8_t shape_count;
+
+uint8_t mux_sprites;
+
+/* Only used building a shape: the dy where each sprite is free again */
+static uint8_t sprite_free_dy[8];
+static uint8_t shape_events;
+
+void mux_clear(void)
+{
+    shape_count = 0;
+    shape_events = 0;
+    mux_sprites = 0;
+}
+
+bool mux_add(uint8_t dy, uint8_t pool, uint8_t ptr, uint8_t color)
+{
+    uint8_t sprite = 8;
+    uint8_t free = pool & ~mux_sprites;
+    uint8_t bit;
+    uint8_t i;
+
+    if (shape_count == MUX_MAX_SHAPE) {
+        return false;
+    }
+
+    if (free) {
+        /* A sprite of its own needs no event */
+        for (i = 0, bit = 1; !(free & bit); i++, bit <<= 1);
+        sprite = i;
+    } else if (shape_events < MUX_MAX_EVENTS) {
+        /* Reuse whichever was done with first */
+        for (i = 0, bit = 1; i < 8; i++, bit <<= 1) {
+            if (!(pool & bit) || sprite_free_dy[i] + MUX_LEAD > dy)
+                continue;
+            if (sprite == 8 || sprite_free_dy[i] < sprite_free_dy[sprite])
+                sprite = i;
+        }
+    }
+    if (sprite == 8) {
+        return false;
+    }
+
+    bit = 1 << sprite;
+    shape_reuse[shape_count] = !!(mux_sprites & bit);
+    if (shape_reuse[shape_count]) {
+        shape_events++;
+    }
+    mux_sprites |= bit;
+    sprite_free_dy[sprite] = dy + ((VIC.spr_exp_y & bit) ? 2*SPRITE_LINES : SPRITE_LINES);
+
+    shape_dy[shape_count] = dy;
+    shape_sprite[shape_count] = sprite;
+    shape_ptr[shape_count] = ptr;
+    shape_color[shape_count] = color;
+    shape_count++;
+    return true;
+}
+
+void mux_frame(uint16_t x, uint8_t y)
+{
+    uint8_t count = shape_count;
+    uint8_t events = 0;
+    uint8_t sprite;
+    uint8_t top;
+    uint8_t i;
+
+    for (i = 0; i < count; i++) {
+        sprite = shape_sprite[i];
+        top = y + shape_dy[i];
+        /* Nothing to show past the bottom of the screen */
+        if (top < y || top >= RASTER_MAX) {
+            top = MUX_HIDDEN_Y;
+        }
+
+        if (!shape_reuse[i]) {
+            VIC.spr_pos[sprite].x = (uint8_t)x;
+            VIC.spr_pos[sprite].y = top;
+            set_sprite_ptr(sprite, shape_ptr[i]);
+            VIC.spr_color[sprite] = shape_color[i];
+        } else if (top != MUX_HIDDEN_Y) {
+            mux_line[events] = top - MUX_LEAD;
+            mux_sprite[events] = sprite;
+            mux_y[events] = top;
+            mux_ptr[events] = shape_ptr[i];
+            mux_color[events] = shape_color[i];
+            events++;
+        }
+    }
+
+    /* After the last event the next interrupt is the frame one again */
+    mux_line[events] = RASTER_MAX;
+    mux_count = events;
+    mux_next = 0;
+    VIC.rasterline = mux_line[0];
+}
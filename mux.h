@@ -0,0 +1,53 @@
+#ifndef _MUX_H_
+#define _MUX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Raster interrupt sprite multiplexer, for drawing a shape taller than the
+ * eight hardware sprites allow. The foreground describes the shape once
+ * with mux_add(), as sprite instances at line offsets below its top. Each
+ * frame frame_irq() calls mux_frame() with where the shape is; instances
+ * that reuse a sprite further down are then made by muxirq.s part way down
+ * the screen, MUX_LEAD lines before they start.
+ */
+
+/* Most sprite reuses in a frame. Keep in sync with muxirq.s */
+#define MUX_MAX_EVENTS  8
+/* Most instances in a shape */
+#define MUX_MAX_SHAPE   16
+
+/* Lines ahead of an instance that its sprite is moved */
+#define MUX_LEAD        4
+
+/* Event tables for muxirq.s, written by mux_frame() */
+extern uint8_t mux_line[MUX_MAX_EVENTS + 1];
+extern uint8_t mux_sprite[MUX_MAX_EVENTS];
+extern uint8_t mux_y[MUX_MAX_EVENTS];
+extern uint8_t mux_ptr[MUX_MAX_EVENTS];
+extern uint8_t mux_color[MUX_MAX_EVENTS];
+extern uint8_t mux_count;
+extern uint8_t mux_next;
+
+/* Sprites the shape uses */
+extern uint8_t mux_sprites;
+
+/* Start a new, empty shape */
+void mux_clear(void);
+
+/*
+ * Add an instance dy lines below the top of the shape, on one of the
+ * sprites in pool. Instances must be added top to bottom. Returns false
+ * when no sprite in pool is free by then.
+ */
+bool mux_add(uint8_t dy, uint8_t pool, uint8_t ptr, uint8_t color);
+
+/*
+ * Place the shape with its top at sprite position x, y for the coming
+ * frame. Only called from frame_irq(), between the last event of one frame
+ * and the first of the next.
+ */
+void mux_frame(uint16_t x, uint8_t y);
+
+#endif
@@ -0,0 +1,94 @@
+; Raster interrupt sprite multiplexer, see mux.h.
+;
+; Registered as an interruptor ahead of set_irq()'s handler. For the raster
+; interrupts it arms part way down the screen it makes the sprite register
+; changes that are due and returns from the interrupt itself, so the C
+; handler and the KERNAL (keyboard scan, jiffy clock) still run only once
+; per frame, on the RASTER_MAX interrupt.
+
+    .include "c64.inc"
+
+    .import _SCREENMEM, _SCREENMEM2
+
+    .export _mux_line, _mux_sprite, _mux_y, _mux_ptr, _mux_color
+    .export _mux_count, _mux_next
+
+MUX_MAX_EVENTS = 8      ; Keep in sync with mux.h
+
+; Each screen page has its own pointers, so set both and it doesn't matter
+; which is shown
+SPRITE_PTRS = _SCREENMEM + $3f8
+SPRITE_PTRS2 = _SCREENMEM2 + $3f8
+
+; KERNAL IRQ exit: pla/tay, pla/tax, pla, rti
+KERNAL_IRQ_RETURN = $ea81
+
+    .bss
+_mux_line:      .res MUX_MAX_EVENTS + 1
+_mux_sprite:    .res MUX_MAX_EVENTS
+_mux_y:         .res MUX_MAX_EVENTS
+_mux_ptr:       .res MUX_MAX_EVENTS
+_mux_color:     .res MUX_MAX_EVENTS
+_mux_count:     .res 1
+_mux_next:      .res 1
+
+    ; Higher priority interruptors are called first
+    .interruptor mux_irq, 20
+
+    .code
+mux_irq:
+    lda VIC_IRR
+    lsr a                   ; Raster bit into carry
+    bcc @not_ours
+    ldx _mux_next
+    cpx _mux_count
+    bcs @not_ours           ; Done for this frame, so it's the frame interrupt
+
+    lda #$01
+    sta VIC_IRR
+    ; Setting the compare to the line we're on can set the flag again after
+    ; that event was made below, so make sure this one is really due
+    lda _mux_line,x
+    cmp VIC_HLINE
+    beq @event
+    bcs @return
+
+@event:
+    ldy _mux_sprite,x
+    lda _mux_color,x
+    sta VIC_SPR0_COLOR,y
+    lda _mux_ptr,x
+    sta SPRITE_PTRS,y
+    sta SPRITE_PTRS2,y
+    tya
+    asl a
+    tay
+    lda _mux_y,x
+    sta VIC_SPR0_Y,y
+    inx
+
+    ; _mux_line[_mux_count] is RASTER_MAX, which hands back to frame_irq()
+    lda _mux_line,x
+    sta VIC_HLINE
+    cpx _mux_count
+    bcs @done
+    ; The next event may already be due, and then its interrupt won't come
+    cmp VIC_HLINE
+    beq @event
+    bcc @event
+
+@done:
+    stx _mux_next
+
+@return:
+    ; Drop the return addresses of callirq and the IRQ stub and leave
+    ; through the KERNAL's register restore
+    pla
+    pla
+    pla
+    pla
+    jmp KERNAL_IRQ_RETURN
+
+@not_ours:
+    clc
+    rts
@@ -0,0 +1,95 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <cbm.h>
+
+#include "prof.h"
+
+struct prof_entry prof_table[PROF_NUM];
+uint16_t prof_overruns;
+
+/* Cycles an empty PROF_ENTER()/PROF_EXIT() pair measures */
+static uint32_t prof_overhead;
+
+/* Timer A counts down every cycle, timer B counts timer A underflows */
+static uint32_t prof_clock(void)
+{
+    uint8_t bl, bh, al, ah;
+
+    do {
+        bh = CIA2.tb_hi;
+        bl = CIA2.tb_lo;
+        ah = CIA2.ta_hi;
+        al = CIA2.ta_lo;
+        /* Retry if a low byte wrapped while we were reading, which
+           changes the high byte read before it */
+    } while (ah != CIA2.ta_hi || bl != CIA2.tb_lo || bh != CIA2.tb_hi);
+
+    return ((uint32_t)((bh << 8) | bl) << 16) | (uint16_t)((ah << 8) | al);
+}
+
+static void prof_reset(void)
+{
+    uint8_t i;
+
+    memset(prof_table, 0, sizeof(prof_table));
+    for (i = 0; i < PROF_NUM; i++) {
+        prof_table[i].min = 0xffffffff;
+    }
+    prof_overruns = 0;
+}
+
+void prof_init(void)
+{
+    uint8_t i;
+
+    /* No NMIs from the timers, which the KERNAL only uses for RS232 */
+    CIA2.icr = 0x7f;
+    CIA2.cra = 0;
+    CIA2.crb = 0;
+    CIA2.ta_lo = 0xff;
+    CIA2.ta_hi = 0xff;
+    CIA2.tb_lo = 0xff;
+    CIA2.tb_hi = 0xff;
+    /* Start, force load, count timer A underflows */
+    CIA2.crb = 0x51;
+    /* Start, force load, continuous, count cycles */
+    CIA2.cra = 0x11;
+
+    prof_overhead = 0;
+    prof_reset();
+    for (i = 0; i < 8; i++) {
+        prof_enter(0);
+        prof_exit(0);
+    }
+    prof_overhead = prof_table[0].min;
+    prof_reset();
+}
+
+void __fastcall__ prof_enter(uint8_t id)
+{
+    struct prof_entry *e = &prof_table[id];
+
+    e->line = VIC.rasterline;
+    e->start = prof_clock();
+}
+
+void __fastcall__ prof_exit(uint8_t id)
+{
+    uint32_t elapsed = prof_clock();
+    struct prof_entry *e = &prof_table[id];
+
+    /* The clock counts down */
+    elapsed = e->start - elapsed;
+    if (elapsed > prof_overhead)
+        elapsed -= prof_overhead;
+    else
+        elapsed = 0;
+
+    e->calls++;
+    e->total += elapsed;
+    if (elapsed < e->min)
+        e->min = elapsed;
+    if (elapsed > e->max)
+        e->max = elapsed;
+}
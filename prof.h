@@ -0,0 +1,57 @@
+#ifndef _PROF_H_
+#define _PROF_H_
+
+#include <stdint.h>
+
+/*
+ * Cycle profiler, built in with -DPROFILE ('make profile'). Instrumented
+ * routines call PROF_ENTER()/PROF_EXIT() with their id; the cycles in
+ * between, less the profiler's own overhead, are accumulated in
+ * prof_table. Cycles come from CIA2 timers A and B cascaded into a 32 bit
+ * down counter, so the time of any interrupt taken meanwhile is included.
+ * A routine must not recurse into its own id.
+ *
+ * From the VICE monitor (after load_labels "shenzhen-prof.lbl"):
+ *     m ._prof_table     19 bytes per id, in enum prof_id order
+ *     m ._prof_overruns  16 bit count of frames the foreground overran
+ */
+
+enum prof_id {
+    PROF_CARDS,
+    PROF_DRAW_STACK,
+    PROF_CHECK_MOVES,
+    PROF_PERSONIFY,
+    PROF_JOY2,
+    PROF_FRAME_IRQ,
+    PROF_NUM,
+};
+
+struct prof_entry {
+    uint32_t start;     /* Clock at the last entry */
+    uint32_t total;
+    uint32_t min;
+    uint32_t max;
+    uint16_t calls;
+    uint8_t line;       /* Raster line at the last entry */
+};
+
+#if defined(PROFILE) && defined(__CC65__)
+extern struct prof_entry prof_table[PROF_NUM];
+extern uint16_t prof_overruns;
+
+void prof_init(void);
+void __fastcall__ prof_enter(uint8_t id);
+void __fastcall__ prof_exit(uint8_t id);
+
+#define PROF_INIT()         prof_init()
+#define PROF_ENTER(id)      prof_enter(id)
+#define PROF_EXIT(id)       prof_exit(id)
+#define PROF_OVERRUN(n)     (prof_overruns += (n))
+#else
+#define PROF_INIT()
+#define PROF_ENTER(id)
+#define PROF_EXIT(id)
+#define PROF_OVERRUN(n)
+#endif
+
+#endif
@@ -0,0 +1,199 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <6502.h>
+
+#include "game.h"
+#include "mouse.h"
+#include "replay.h"
+
+#ifdef RECORD
+
+uint8_t replay_stream[REPLAY_MAX];
+uint16_t replay_length;
+
+/* Where the run frames can still be added to is, if run_open */
+static uint16_t run_at;
+static bool run_open;
+/* Set once the stream is full, after which nothing more is recorded */
+static bool full;
+
+/* Room for count more bytes, leaving one for the end */
+static bool reserve(uint8_t count)
+{
+    if (replay_length + count >= REPLAY_MAX) {
+        full = true;
+    }
+    return !full;
+}
+
+void __fastcall__ replay_record_frame(uint8_t input)
+{
+    uint8_t *run = &replay_stream[run_at];
+
+    if (mouse_dx || mouse_dy) {
+        input |= REPLAY_MOUSE;
+    }
+    if (run_open && run[0] < REPLAY_RUN_MAX - 1 && run[1] == input &&
+            (!(input & REPLAY_MOUSE) ||
+             (run[2] == (uint8_t)mouse_dx && run[3] == (uint8_t)mouse_dy))) {
+        run[0]++;
+        return;
+    }
+
+    if (!reserve(input & REPLAY_MOUSE ? 4 : 2)) {
+        return;
+    }
+    run_at = replay_length;
+    run_open = true;
+    replay_stream[replay_length++] = 0;
+    replay_stream[replay_length++] = input;
+    if (input & REPLAY_MOUSE) {
+        replay_stream[replay_length++] = mouse_dx;
+        replay_stream[replay_length++] = mouse_dy;
+    }
+}
+
+/* From the foreground, so frame_irq() must not add to the stream meanwhile */
+static void record_event(uint8_t tag, uint8_t value)
+{
+    SEI();
+    if (reserve(2)) {
+        replay_stream[replay_length++] = tag;
+        replay_stream[replay_length++] = value;
+        run_open = false;
+    }
+    CLI();
+}
+
+char __fastcall__ replay_record_key(char key)
+{
+    if (key) {
+        record_event(REPLAY_TAG_KEY, key);
+    }
+    return key;
+}
+
+uint8_t __fastcall__ replay_record_rand(uint8_t value)
+{
+    record_event(REPLAY_TAG_RAND, value);
+    return value;
+}
+
+void replay_finish(uint16_t seed)
+{
+    (void)seed;
+    SEI();
+    replay_stream[replay_length++] = REPLAY_TAG_END;
+    run_open = false;
+    full = true;
+    CLI();
+}
+
+#endif
+
+#ifdef REPLAY
+
+volatile bool replay_done;
+/* Frames played, and the final state, for replay.py */
+uint16_t replay_frames;
+uint8_t replay_state[SAVE_MAX];
+uint8_t replay_state_length;
+
+static const uint8_t *next = replay_stream;
+
+/* The run being played */
+static uint8_t run_left;
+static uint8_t run_input;
+static int8_t run_dx;
+static int8_t run_dy;
+
+/*
+ * Keys frame_irq() has reached that key_process() hasn't taken, as it
+ * doesn't while cards fly.
+ */
+#define KEY_QUEUE_SIZE  8
+static char key_queue[KEY_QUEUE_SIZE];
+static volatile uint8_t key_head;
+static volatile uint8_t key_tail;
+
+static volatile bool rand_ready;
+static uint8_t rand_value;
+
+/*
+ * Take the keys and random numbers recorded after the last frame played,
+ * up to the next run. They happened before the next frame, so the
+ * foreground must have them before frame_irq() gets to it.
+ */
+static void read_events(void)
+{
+    for (;;) {
+        switch (*next) {
+            case REPLAY_TAG_KEY:
+                key_queue[key_head++ % KEY_QUEUE_SIZE] = next[1];
+                break;
+            case REPLAY_TAG_RAND:
+                rand_value = next[1];
+                rand_ready = true;
+                break;
+            default:
+                return;
+        }
+        next += 2;
+    }
+}
+
+uint8_t replay_frame(void)
+{
+    if (!run_left) {
+        /* Only anything recorded before the first frame */
+        read_events();
+        if (*next == REPLAY_TAG_END) {
+            /* Stay on the end, with nothing pressed */
+            replay_done = true;
+            mouse_dx = 0;
+            mouse_dy = 0;
+            return 0;
+        }
+        run_left = *next++ + 1;
+        run_input = *next++;
+        run_dx = 0;
+        run_dy = 0;
+        if (run_input & REPLAY_MOUSE) {
+            run_dx = *next++;
+            run_dy = *next++;
+        }
+    }
+
+    run_left--;
+    replay_frames++;
+    mouse_dx = run_dx;
+    mouse_dy = run_dy;
+    if (!run_left) {
+        read_events();
+    }
+    return run_input & ~REPLAY_MOUSE;
+}
+
+char replay_key(void)
+{
+    if (key_tail == key_head) {
+        return 0;
+    }
+    return key_queue[key_tail++ % KEY_QUEUE_SIZE];
+}
+
+/* The foreground may get here first, so wait for frame_irq() to read it */
+uint8_t replay_rand(void)
+{
+    while (!rand_ready && !replay_done);
+    rand_ready = false;
+    return rand_value;
+}
+
+void replay_finish(uint16_t seed)
+{
+    replay_state_length = save_game(replay_state, seed);
+}
+
+#endif
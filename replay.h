@@ -0,0 +1,82 @@
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Input recording and replay, for playing the same session on two builds
+ * and comparing them. 'make record' builds with -DRECORD, which notes
+ * everything the game reads from the player as it plays: each frame's
+ * joystick, button and mouse deltas, the keys key_process() takes and the
+ * random numbers that pick deals. 'make replay' builds with -DREPLAY (and
+ * the profiler) and plays replay.bin back in place of the hardware, then
+ * replay.py reads the final state and overrun count out of VICE.
+ *
+ * The stream is a list of records, in the order they happened:
+ *
+ *   $00-$7f  n  input [dx dy]  the same input for n + 1 frames: JOY_* bits,
+ *                              and REPLAY_MOUSE if mouse deltas follow
+ *   $80      key               key_process() took key before the next frame
+ *   $81      value             hal_rand() returned value
+ *   $ff                        end
+ *
+ * To save a recording, after quitting, from the VICE monitor (with
+ * load_labels "shenzhen-record.lbl"):
+ *     m ._replay_length          16 bit length of the stream
+ *     bsave "replay.bin" 0 ._replay_stream <._replay_stream + length - 1>
+ */
+
+#define REPLAY_MOUSE    0x80
+#define REPLAY_RUN_MAX  0x80
+
+enum replay_tag {
+    REPLAY_TAG_KEY = 0x80,
+    REPLAY_TAG_RAND,
+    REPLAY_TAG_END = 0xff,
+};
+
+#if defined(RECORD) && defined(__CC65__)
+/* Longest recording. A frame of mouse movement takes 4 bytes, else 2 */
+#define REPLAY_MAX      8192
+
+extern uint8_t replay_stream[REPLAY_MAX];
+extern uint16_t replay_length;
+
+/* From frame_irq(), with mouse_dx and mouse_dy already read */
+void __fastcall__ replay_record_frame(uint8_t input);
+char __fastcall__ replay_record_key(char key);
+uint8_t __fastcall__ replay_record_rand(uint8_t value);
+void replay_finish(uint16_t seed);
+
+#define REPLAY_INPUT(input)     replay_record_frame(input)
+#define REPLAY_KEY(key)         replay_record_key(key)
+#define REPLAY_RAND(value)      replay_record_rand(value)
+#define REPLAY_DONE()           false
+#define REPLAY_FINISH(seed)     replay_finish(seed)
+#elif defined(REPLAY) && defined(__CC65__)
+extern const uint8_t replay_stream[];
+/* Set once the stream has run out */
+extern volatile bool replay_done;
+
+/* From frame_irq(): the recorded input, and mouse_dx and mouse_dy */
+uint8_t replay_frame(void);
+char replay_key(void);
+uint8_t replay_rand(void);
+/* Keep the final state for replay.py */
+void replay_finish(uint16_t seed);
+
+#define REPLAY_INPUT(input)     ((input) = replay_frame())
+#define REPLAY_KEY(key)         replay_key()
+#define REPLAY_RAND(value)      replay_rand()
+#define REPLAY_DONE()           replay_done
+#define REPLAY_FINISH(seed)     replay_finish(seed)
+#else
+#define REPLAY_INPUT(input)
+#define REPLAY_KEY(key)         (key)
+#define REPLAY_RAND(value)      (value)
+#define REPLAY_DONE()           false
+#define REPLAY_FINISH(seed)
+#endif
+
+#endif
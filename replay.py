@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+#
+# Plays a recorded session in VICE and writes what it came to, for
+# comparing builds, see replay.h.
+#
+# Runs the replay build headless with the remote monitor, as bench.py
+# does, and breaks on replay_finish(). Once it returns, the monitor reads
+# the final board (save_game()'s format), the frames played and the
+# profiler's count of frames the foreground overran. The build then quits
+# VICE through the debug cartridge.
+#
+# Two runs of the same replay.bin should give the same board and frames.
+# The overruns are what's expected to change.
+#
+# Usage: replay.py PROGRAM LABELS OUTPUT.json
+
+import json
+import re
+import subprocess
+import sys
+
+from bench import LIMIT_CYCLES, Monitor, PORT, X64SC, load_labels
+
+# Safety net: longer than any game anyone would record
+REPLAY_LIMIT_CYCLES = 30 * LIMIT_CYCLES
+
+MEMORY_LINE = re.compile(r">C:([0-9a-f]{4})\s+((?:[0-9a-f]{2}\s)+)")
+
+
+def read_memory(mon, addr, count):
+    data = []
+    for line in mon.cmd("m $%04x $%04x" % (addr, addr + count - 1)).splitlines():
+        m = MEMORY_LINE.match(line.strip())
+        if m:
+            data += [int(b, 16) for b in m.group(2).split()]
+    return data[:count]
+
+
+def read_word(mon, addr):
+    lo, hi = read_memory(mon, addr, 2)
+    return lo | hi << 8
+
+
+def main():
+    program, label_file, output = sys.argv[1:4]
+    labels = load_labels(label_file)
+    for name in ("replay_finish", "replay_state", "replay_state_length",
+                 "replay_frames", "prof_overruns"):
+        if "_" + name not in labels:
+            raise SystemExit("no label for %s in %s" % (name, label_file))
+
+    vice = subprocess.Popen([
+        X64SC, "-default", "-warp", "-debugcart",
+        "-limitcycles", str(REPLAY_LIMIT_CYCLES),
+        "-remotemonitor", "-remotemonitoraddress", "ip4://127.0.0.1:%d" % PORT,
+        "-autostartprgmode", "1", "-autostart", program,
+    ])
+
+    mon = Monitor(PORT)
+    mon.cmd("r")
+    mon.cmd("break $%04x" % labels["_replay_finish"])
+    mon.go()
+    pc, _ = mon.wait_prompt()
+    if pc is None:
+        raise SystemExit("replay did not finish")
+
+    regs = mon.cmd("r").splitlines()[-1].split()
+    sp = int(regs[4], 16)
+    stack = mon.cmd("m $%04x $%04x" % (0x101 + sp, 0x102 + sp)).split()
+    ret = (int(stack[2], 16) << 8 | int(stack[1], 16)) + 1
+    mon.cmd("until $%04x" % ret)
+
+    length = read_memory(mon, labels["_replay_state_length"], 1)[0]
+    report = {
+        "program": program,
+        "frames": read_word(mon, labels["_replay_frames"]),
+        "overruns": read_word(mon, labels["_prof_overruns"]),
+        "state": bytes(read_memory(mon, labels["_replay_state"], length)).hex(),
+    }
+    mon.go()
+    vice.wait()
+    report["exit_code"] = vice.returncode
+
+    with open(output, "w") as f:
+        json.dump(report, f, indent=2, sort_keys=True)
+        f.write("\n")
+
+    print("frames %d  overruns %d" % (report["frames"], report["overruns"]))
+
+    if vice.returncode != 0:
+        raise SystemExit("replay run did not finish (exit code %d)" % vice.returncode)
+
+
+if __name__ == "__main__":
+    main()
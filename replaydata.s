@@ -0,0 +1,7 @@
+; The session 'make replay' plays back, see replay.h
+
+    .export _replay_stream
+
+    .rodata
+_replay_stream:
+    .incbin "replay.bin"
@@ -9,6 +9,25 @@
 
 #define BANK_REG (*(volatile char *)0x01)
 
+/* VIC bank CHARMEM is linked into, see the .cfg files. Keep in sync with charset.s */
+#ifdef CART
+#define VIC_BANK    1
+#else
+#define VIC_BANK    3
+#endif
+/* CIA2 port A bits that pick the bank, inverted */
+#define VIC_BANK_BITS   0x03
+
+/* SCREENMEM is shown first, so drawing starts on the other page */
+struct screen_memory *screen_draw = &SCREENMEM2;
+uint8_t screen_page = 1;
+uint8_t color_shadow[SCREENMEM_SIZE];
+
+/* Slots drawn in each row since the last flip, and the rows with any */
+static uint8_t screen_dirty[SCREEN_HEIGHT];
+static uint8_t dirty_top = SCREEN_HEIGHT;
+static uint8_t dirty_bottom;
+
 /*
  * Copy the character ROM to our CHARMEM reservation
  */
@@ -28,22 +47,28 @@ void copy_character_rom(void)
 }
 
 static uint8_t old_screenreg;
+static uint8_t old_bank;
 
 void set_screen_addr(void)
 {
     old_screenreg = VIC.addr;
+    old_bank = CIA2.pra & VIC_BANK_BITS;
+    CIA2.pra = (CIA2.pra & ~VIC_BANK_BITS) | (VIC_BANK_BITS - VIC_BANK);
     VIC.addr = (char)&SCREENREG;
+    screen_draw = &SCREENMEM2;
+    screen_page = 1;
 }
 
 void restore_screen_addr(void)
 {
     VIC.bgcolor0 = COLOR_BLUE;
     VIC.addr = old_screenreg;
+    CIA2.pra = (CIA2.pra & ~VIC_BANK_BITS) | old_bank;
 }
 
 void init_screen(void)
 {
-    char *addr = &get_screen_mem()->mem[0];
+    char *addr = &SCREENMEM.mem[0];
 
 #if 0
     /* Display all the characters */
@@ -55,7 +80,9 @@ void init_screen(void)
     }
 #endif
     memset(addr, BG_CHAR, SCREEN_SIZE);
+    memset(SCREENMEM2.mem, BG_CHAR, SCREEN_SIZE);
     memset(COLOR_RAM, BG_CHAR_COLOR, SCREEN_SIZE);
+    memset(color_shadow, BG_CHAR_COLOR, SCREEN_SIZE);
     /* Set Extended Background Color Mode */
     VIC.ctrl1 |= (1 << 6);
     VIC.bordercolor = COLOR_BLACK;
@@ -65,3 +92,87 @@ void init_screen(void)
     VIC.bgcolor3 = COLOR_GRAY2;
 }
 
+void screen_mark(uint8_t slot, uint8_t first, uint8_t last)
+{
+    uint8_t bit = 1 << slot;
+
+    if (first < dirty_top)
+        dirty_top = first;
+    if (last > dirty_bottom)
+        dirty_bottom = last;
+    for (; first <= last; first++) {
+        screen_dirty[first] |= bit;
+    }
+}
+
+/*
+ * Copy the marked slots of rows dirty_top to dirty_bottom from one buffer to
+ * another, both laid out like the screen.
+ */
+static void copy_dirty(uint8_t *to, const uint8_t *from)
+{
+    uint16_t offset = dirty_top * SCREEN_WIDTH;
+    uint8_t row;
+    uint8_t bits;
+    uint8_t x;
+
+    for (row = dirty_top; row <= dirty_bottom; row++) {
+        for (bits = screen_dirty[row], x = 0; bits; bits >>= 1, x += SCREEN_SLOT_WIDTH) {
+            if (bits & 1)
+                memcpy(&to[offset + x], &from[offset + x], SCREEN_SLOT_CHARS);
+        }
+        offset += SCREEN_WIDTH;
+    }
+}
+
+/*
+ * Colour RAM can't be paged, so it follows the flip in the border. Redrawing
+ * most of the screen at once (a new deal) is more than the border has time
+ * for, and then the colours catch up with the characters a frame later.
+ */
+void screen_present(void)
+{
+    uint8_t *shown;
+
+    if (dirty_top > dirty_bottom)
+        return;
+
+    VIC.addr = screen_page ? (char)&SCREENREG2 : (char)&SCREENREG;
+    copy_dirty(COLOR_RAM, color_shadow);
+
+    /* Bring the page now hidden up to date before drawing on it again */
+    shown = (uint8_t *)screen_draw->mem;
+    screen_page ^= 1;
+    screen_draw = screen_page ? &SCREENMEM2 : &SCREENMEM;
+    copy_dirty((uint8_t *)screen_draw->mem, shown);
+
+    memset(&screen_dirty[dirty_top], 0, dirty_bottom - dirty_top + 1);
+    dirty_top = SCREEN_HEIGHT;
+    dirty_bottom = 0;
+}
+
+/*
+ * Fire the VIC raster interrupt once per frame at the given line (< 256).
+ * The CIA1 timer interrupt is masked so the KERNAL's keyboard scan and
+ * jiffy clock run off the raster tick instead of a free-running timer.
+ */
+void raster_irq_start(uint8_t line)
+{
+    SEI();
+    CIA1.icr = 0x7f;
+    VIC.rasterline = line;
+    VIC.ctrl1 &= ~(1 << 7);
+    VIC.irr = 0xff;
+    VIC.imr = VIC_IRQ_RASTER;
+    CLI();
+}
+
+void raster_irq_stop(void)
+{
+    SEI();
+    VIC.imr = 0;
+    VIC.irr = 0xff;
+    /* Give the KERNAL back its timer A interrupt */
+    CIA1.icr = 0x81;
+    CLI();
+}
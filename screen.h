@@ -5,6 +5,24 @@ void copy_character_rom(void);
 void set_screen_addr(void);
 void restore_screen_addr(void);
 void init_screen(void);
+void raster_irq_start(uint8_t line);
+void raster_irq_stop(void);
+
+/*
+ * Everything is drawn CARD_WIDTH columns wide, in one of SCREEN_SLOTS slots
+ * SCREEN_SLOT_WIDTH columns apart. Drawing marks the rows it changes in a
+ * slot with screen_mark(), and screen_present() then shows them all at once.
+ */
+#define SCREEN_SLOTS        8
+#define SCREEN_SLOT_WIDTH   5
+#define SCREEN_SLOT_CHARS   4
+void screen_mark(uint8_t slot, uint8_t first, uint8_t last);
+
+/*
+ * Flip to the page that was drawn on and commit its colours. Called just
+ * after the frame IRQ, so that happens while the lower border is shown.
+ */
+void screen_present(void);
 
 #define SCREEN_WIDTH    40
 #define SCREEN_HEIGHT   25
@@ -16,6 +34,13 @@ void init_screen(void);
  */
 #define char_offset(val) ((val) - 64)
 
+/* First and one-past-last raster lines of the 25 row text area */
+#define RASTER_MIN      51
+#define RASTER_MAX      (RASTER_MIN + SCREEN_HEIGHT * 8)
+
+/* VIC.irr / VIC.imr raster interrupt bit */
+#define VIC_IRQ_RASTER  (1 << 0)
+
 #define BG_CHAR_COLOR   COLOR_GREEN
 #define BG_CHAR         ((2 << 6) | char_offset(94)) /* Checker pattern with BG color 2 */
 #endif
@@ -0,0 +1,15 @@
+#ifndef _SEEDS_H_
+#define _SEEDS_H_
+
+#include <stdint.h>
+
+/*
+ * Deal seeds the solver has found a solution for. seeds.c is generated at
+ * build time by 'shenzhen-solve -t', see the Makefile. There are 256 so a
+ * random byte picks one directly.
+ */
+#define NUM_SOLVABLE_SEEDS  256
+
+extern const uint16_t solvable_seeds[NUM_SOLVABLE_SEEDS];
+
+#endif
@@ -0,0 +1,245 @@
+/*
+ * Solve a run of deals and check each solution against the real rules. A
+ * deal is named by its seed, see deck.h. Every solution found is replayed
+ * through take_run()/drop_run()/check_moves() and must end the game, so a
+ * rule change in game.c that the solver does not know about shows up as a
+ * replay failure. As on the C64, finish_game() takes over from
+ * check_moves() once finish_ready() says the rest is automatic, so its
+ * plan is checked too. The finished game is then undone back to the deal
+ * and redone to the end, which checks the move journal too, and played
+ * once more with a save and restore half way, which checks saved games.
+ *
+ *     make solve && ./shenzhen-solve [deals] [first seed] [node limit]
+ *
+ * With -t, prints seeds.c instead: the first NUM_SOLVABLE_SEEDS seeds from
+ * the first seed on that have a solution which replays.
+ *
+ *     ./shenzhen-solve -t [first seed] [node limit] > seeds.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "game.h"
+#include "deck.h"
+#include "seeds.h"
+#include "solver.h"
+
+/* The board as dealt, to check undo against */
+static card_t dealt_stacks[NUM_STACKS][STACK_MAX_CARDS];
+static card_t dealt_cells[NUM_CELLS];
+static card_t dealt_done[4];
+
+static bool at_deal(void)
+{
+    return memcmp(stacks, dealt_stacks, sizeof(stacks)) == 0 &&
+           memcmp(freecells, dealt_cells, sizeof(freecells)) == 0 &&
+           memcmp(done_stack, dealt_done, sizeof(done_stack)) == 0;
+}
+
+/* Make moves from to to of a solution, as the player would */
+static bool play_moves(const struct solution *sol, unsigned from, unsigned to)
+{
+    const struct move *m;
+    unsigned i;
+
+    for (i = from; i < to; i++) {
+        m = &sol->moves[i];
+        /* Take exactly the top count cards */
+        if (take_run(m->src, m->src < NUM_STACKS ? stack_height[m->src] - m->count : 0) != m->count)
+            return false;
+        drop_run(m->dst, m->count);
+        if (finish_ready())
+            finish_game();
+        else
+            check_moves();
+    }
+    return true;
+}
+
+/* Play half the solution, save and restore the game, then play the rest */
+static bool replay_restored(uint16_t seed, const struct solution *sol)
+{
+    static uint8_t saved[SAVE_MAX];
+    static uint8_t again[SAVE_MAX];
+    unsigned half = sol->length / 2;
+    uint16_t restored_seed;
+    uint8_t len;
+
+    cards(seed);
+    if (!play_moves(sol, 0, half))
+        return false;
+    len = save_game(saved, seed);
+    if (!restore_game(saved, len, &restored_seed) || restored_seed != seed)
+        return false;
+    /* Restoring rebuilt the same game */
+    if (save_game(again, seed) != len || memcmp(saved, again, len) != 0)
+        return false;
+    return play_moves(sol, half, sol->length) && game_over;
+}
+
+static bool replay(uint16_t seed, const struct solution *sol)
+{
+    unsigned i, undone;
+
+    cards(seed);
+    memcpy(dealt_stacks, stacks, sizeof(stacks));
+    memcpy(dealt_cells, freecells, sizeof(freecells));
+    memcpy(dealt_done, done_stack, sizeof(done_stack));
+
+    if (!play_moves(sol, 0, sol->length) || !game_over)
+        return false;
+
+    /* The journal may have dropped the first moves of a long game */
+    for (undone = 0; undo_move(); undone++)
+        ;
+    if (undone > sol->length || (undone == sol->length && !at_deal()))
+        return false;
+    for (i = 0; i < undone; i++)
+        if (!redo_move())
+            return false;
+    if (!game_over || redo_move())
+        return false;
+
+    return replay_restored(seed, sol);
+}
+
+static void solve_seed(struct solver *s, uint16_t seed, struct solution *sol)
+{
+    static card_t deck[DECK_SIZE];
+    struct board b;
+
+    make_deck(deck, seed);
+    board_deal(&b, deck);
+    board_auto_moves(&b);
+    solve(s, &b, sol);
+}
+
+static int print_table(struct solver *s, uint16_t seed)
+{
+    static struct solution sol;
+    unsigned n = 0;
+
+    printf("/* Generated by 'shenzhen-solve -t', do not edit */\n");
+    printf("#include \"seeds.h\"\n\n");
+    printf("const uint16_t solvable_seeds[NUM_SOLVABLE_SEEDS] = {");
+    while (n < NUM_SOLVABLE_SEEDS) {
+        if (seed == 0) {
+            fprintf(stderr, "ran out of seeds\n");
+            return 1;
+        }
+        solve_seed(s, seed, &sol);
+        if (sol.solved && replay(seed, &sol)) {
+            printf("%s0x%04x,", n % 8 ? " " : "\n    ", seed);
+            n++;
+        }
+        seed++;
+    }
+    printf("\n};\n");
+    return 0;
+}
+
+/* Whole of arg as a number, false if it isn't one */
+static bool parse_number(const char *arg, unsigned long *value)
+{
+    char *end;
+
+    if (*arg < '0' || *arg > '9')
+        return false;
+    *value = strtoul(arg, &end, 0);
+    return *end == '\0';
+}
+
+static int usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [deals] [first seed] [node limit]\n"
+                    "       %s -t [first seed] [node limit]\n", name, name);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long deals = 1000;
+    uint16_t first = 1;
+    unsigned long max_nodes = 1000000;
+    unsigned long solved = 0, unsolvable = 0, gave_up = 0, bad = 0;
+    unsigned long nodes = 0, moves = 0, worst = 0;
+    static struct solution sol;
+    bool table = false;
+    struct solver *s;
+    uint16_t seed;
+    unsigned long i, value;
+    const char *name = argv[0];
+    clock_t start;
+    double secs;
+    int ret;
+
+    if (argc > 1 && strcmp(argv[1], "-t") == 0) {
+        table = true;
+        argv++;
+        argc--;
+    } else if (argc > 1) {
+        if (!parse_number(argv[1], &deals) || !deals)
+            return usage(name);
+        argv++;
+        argc--;
+    }
+    if (argc > 3)
+        return usage(name);
+    if (argc > 1) {
+        if (!parse_number(argv[1], &value) || value > 0xffff)
+            return usage(name);
+        first = (uint16_t)value;
+    }
+    if (argc > 2 && !parse_number(argv[2], &max_nodes))
+        return usage(name);
+
+    s = solver_new(max_nodes);
+    if (!s) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    if (table) {
+        ret = print_table(s, first);
+        solver_free(s);
+        return ret;
+    }
+
+    start = clock();
+    for (i = 0; i < deals; i++) {
+        seed = (uint16_t)(first + i);
+        solve_seed(s, seed, &sol);
+
+        nodes += sol.nodes;
+        if (sol.nodes > worst)
+            worst = sol.nodes;
+        if (sol.solved) {
+            solved++;
+            moves += sol.length;
+            if (!replay(seed, &sol)) {
+                printf("seed 0x%04x: solution does not replay\n", seed);
+                bad++;
+            }
+        } else if (sol.gave_up) {
+            gave_up++;
+        } else {
+            unsolvable++;
+        }
+    }
+    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+    solver_free(s);
+
+    printf("deals:      %lu\n", deals);
+    printf("solved:     %lu (%.1f%%)\n", solved, 100.0 * solved / deals);
+    printf("unsolvable: %lu\n", unsolvable);
+    printf("gave up:    %lu\n", gave_up);
+    if (solved)
+        printf("moves:      %.1f per solution\n", (double)moves / solved);
+    printf("nodes:      %.0f per deal, %lu worst\n", (double)nodes / deals, worst);
+    printf("time:       %.3f ms per deal\n", 1000 * secs / deals);
+
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,469 @@
+/*
+ * Depth first search over the moves a player can make, with a transposition
+ * table of every position already expanded. Positions are keyed so that two
+ * boards differing only in the order of their stacks or free cells collide
+ * on purpose: the rules treat all stacks (and all cells) alike, so a deal
+ * has far fewer distinct positions than it has move orders.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game.h"
+#include "solver.h"
+
+struct solver {
+    uint32_t *table;        /* Index into keys plus 1, 0 = empty slot */
+    size_t mask;
+    struct board_key *keys; /* Expanded positions, half as many as slots */
+    size_t used;
+    unsigned long max_nodes;
+    struct solution *sol;
+};
+
+#define TABLE_INITIAL (1 << 16)
+
+struct solver *solver_new(unsigned long max_nodes)
+{
+    struct solver *s = calloc(1, sizeof(*s));
+
+    if (!s)
+        return NULL;
+    s->table = calloc(TABLE_INITIAL, sizeof(*s->table));
+    s->keys = malloc(TABLE_INITIAL / 2 * sizeof(*s->keys));
+    if (!s->table || !s->keys) {
+        free(s->table);
+        free(s->keys);
+        free(s);
+        return NULL;
+    }
+    s->mask = TABLE_INITIAL - 1;
+    s->max_nodes = max_nodes;
+    return s;
+}
+
+void solver_free(struct solver *s)
+{
+    if (!s)
+        return;
+    free(s->table);
+    free(s->keys);
+    free(s);
+}
+
+void board_deal(struct board *b, const card_t *deck)
+{
+    int j;
+
+    memset(b, 0, sizeof(*b));
+    for (j = 0; j < DECK_SIZE; j++)
+        b->stack[j % NUM_STACKS][b->height[j % NUM_STACKS]++] = deck[j];
+}
+
+bool board_empty(const struct board *b)
+{
+    int i;
+
+    for (i = 0; i < NUM_STACKS; i++)
+        if (b->height[i])
+            return false;
+    for (i = 0; i < NUM_CELLS; i++)
+        if (b->cell[i])
+            return false;
+    return true;
+}
+
+static void collect_dragons(struct board *b, card_t dragon)
+{
+    int i;
+
+    for (i = 0; i < NUM_STACKS; i++)
+        if (b->height[i] && b->stack[i][b->height[i]-1] == dragon)
+            b->height[i]--;
+    for (i = 0; i < NUM_CELLS; i++)
+        if (b->cell[i] == dragon)
+            b->cell[i] = 0;
+}
+
+/*
+ * Every automatic move only removes cards, and removing a card never stops
+ * another from going, so the order the moves are made in does not matter:
+ * any order reaches the same position check_moves() does.
+ */
+void board_auto_moves(struct board *b)
+{
+    static const card_t dragons[3] = {
+        make_card(CARD_DRAGON, RED),
+        make_card(CARD_DRAGON, GREEN),
+        make_card(CARD_DRAGON, BLACK),
+    };
+    uint8_t free_dragons[3];
+    bool rerun;
+    card_t card;
+    int i;
+
+    do {
+        rerun = false;
+        free_dragons[0] = free_dragons[1] = free_dragons[2] = 0;
+
+        for (i = 0; i < NUM_STACKS; i++) {
+            if (!b->height[i])
+                continue;
+            card = b->stack[i][b->height[i]-1];
+            if (card_number(card) == CARD_FLOWER) {
+                b->height[i]--;
+                rerun = true;
+            } else if (card_number(card) == CARD_DRAGON) {
+                free_dragons[card_suit(card)]++;
+            } else if (card_number(card) == b->done[card_suit(card)] + 1) {
+                b->done[card_suit(card)]++;
+                b->height[i]--;
+                rerun = true;
+            }
+        }
+
+        for (i = 0; i < NUM_CELLS; i++) {
+            card = b->cell[i];
+            if (!card)
+                continue;
+            if (card_number(card) == CARD_DRAGON) {
+                free_dragons[card_suit(card)]++;
+            } else if (card_number(card) == b->done[card_suit(card)] + 1) {
+                b->done[card_suit(card)]++;
+                b->cell[i] = 0;
+                rerun = true;
+            }
+        }
+
+        for (i = 0; i < 3; i++) {
+            if (free_dragons[i] == 3) {
+                collect_dragons(b, dragons[i]);
+                rerun = true;
+            }
+        }
+    } while (rerun);
+}
+
+/* splitmix64 finalizer */
+static uint64_t mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/* Sorts stacks by their cards from the bottom up, shorter first on a tie */
+static int stack_cmp(const struct board *b, int i, int j)
+{
+    int n = b->height[i] < b->height[j] ? b->height[i] : b->height[j];
+    int c = memcmp(b->stack[i], b->stack[j], n);
+
+    return c ? c : b->height[i] - b->height[j];
+}
+
+static void key_put(struct board_key *key, unsigned *n, card_t card)
+{
+    key->word[*n / BOARD_KEY_PER_WORD] |= (uint64_t)card << (*n % BOARD_KEY_PER_WORD * 6);
+    (*n)++;
+}
+
+/*
+ * No card is 0, so the 0 after each stack marks where it ends, and the key
+ * is the whole position: two keys match only if the positions do.
+ */
+void board_key(const struct board *b, struct board_key *key)
+{
+    uint8_t order[NUM_STACKS];
+    card_t cells[NUM_CELLS];
+    unsigned n = 0;
+    int i, j;
+
+    for (i = 0; i < NUM_STACKS; i++) {
+        for (j = i; j > 0 && stack_cmp(b, order[j-1], i) > 0; j--)
+            order[j] = order[j-1];
+        order[j] = i;
+    }
+    for (i = 0; i < NUM_CELLS; i++) {
+        for (j = i; j > 0 && cells[j-1] > b->cell[i]; j--)
+            cells[j] = cells[j-1];
+        cells[j] = b->cell[i];
+    }
+
+    memset(key, 0, sizeof(*key));
+    for (i = 0; i < NUM_STACKS; i++) {
+        for (j = 0; j < b->height[order[i]]; j++)
+            key_put(key, &n, b->stack[order[i]][j]);
+        key_put(key, &n, 0);
+    }
+    for (i = 0; i < NUM_CELLS; i++)
+        key_put(key, &n, cells[i]);
+}
+
+/* Only picks the slot to look in, the whole key is compared there */
+static uint64_t key_hash(const struct board_key *key)
+{
+    uint64_t h = 0;
+    int i;
+
+    for (i = 0; i < BOARD_KEY_WORDS; i++)
+        h = mix(h ^ key->word[i]);
+    return h;
+}
+
+static void table_grow(struct solver *s)
+{
+    size_t size = (s->mask + 1) * 2;
+    uint32_t *table = calloc(size, sizeof(*table));
+    struct board_key *keys = realloc(s->keys, size / 2 * sizeof(*keys));
+    size_t i, slot;
+
+    if (!table || !keys)
+        abort();
+    s->keys = keys;
+    for (i = 0; i < s->used; i++) {
+        slot = key_hash(&keys[i]) & (size - 1);
+        while (table[slot])
+            slot = (slot + 1) & (size - 1);
+        table[slot] = i + 1;
+    }
+    free(s->table);
+    s->table = table;
+    s->mask = size - 1;
+}
+
+/* Returns false if key was already there */
+static bool table_insert(struct solver *s, const struct board_key *key)
+{
+    size_t slot;
+
+    /* Also keeps used below the half a table keys has room for */
+    if (s->used * 2 > s->mask)
+        table_grow(s);
+
+    slot = key_hash(key) & s->mask;
+    while (s->table[slot]) {
+        if (memcmp(&s->keys[s->table[slot] - 1], key, sizeof(*key)) == 0)
+            return false;
+        slot = (slot + 1) & s->mask;
+    }
+    s->keys[s->used++] = *key;
+    s->table[slot] = s->used;
+    return true;
+}
+
+/* Whether drop_run() accepts count cards, the lowest being card, on stack i */
+static bool can_stack(const struct board *b, int i, card_t card, uint8_t count)
+{
+    if (b->height[i] + count > STACK_MAX_CARDS)
+        return false;
+    if (!b->height[i])
+        return true;
+    return card_stacks_on(card, b->stack[i][b->height[i]-1]);
+}
+
+/* Number of cards in the run at the top of stack i */
+static uint8_t run_length(const struct board *b, int i)
+{
+    uint8_t n;
+
+    if (!b->height[i])
+        return 0;
+    for (n = 1; n < b->height[i]; n++) {
+        if (!card_stacks_on(b->stack[i][b->height[i]-n], b->stack[i][b->height[i]-n-1]))
+            break;
+    }
+    return n;
+}
+
+static void apply_move(struct board *b, const struct move *m)
+{
+    uint8_t i;
+
+    if (m->src >= NUM_STACKS) {
+        b->stack[m->dst][b->height[m->dst]++] = b->cell[m->src - NUM_STACKS];
+        b->cell[m->src - NUM_STACKS] = 0;
+    } else if (m->dst >= NUM_STACKS) {
+        b->cell[m->dst - NUM_STACKS] = b->stack[m->src][--b->height[m->src]];
+    } else {
+        b->height[m->src] -= m->count;
+        for (i = 0; i < m->count; i++)
+            b->stack[m->dst][b->height[m->dst]++] = b->stack[m->src][b->height[m->src] + i];
+    }
+    board_auto_moves(b);
+}
+
+/*
+ * How far a position looks from solved, lower is better: the cards left,
+ * with extra weight on cards sitting on something they could not have been
+ * dropped on, since each of those has to move again before the stack under
+ * it can be cleared. Only used to order the moves tried.
+ */
+static int board_score(const struct board *b)
+{
+    int score = 0;
+    card_t card, under;
+    int i, j;
+
+    for (i = 0; i < NUM_STACKS; i++) {
+        for (j = 0; j < b->height[i]; j++) {
+            card = b->stack[i][j];
+            score += 2;
+            if (j == 0)
+                continue;
+            under = b->stack[i][j-1];
+            if (!card_stacks_on(card, under))
+                score += 3;
+        }
+    }
+    for (i = 0; i < NUM_CELLS; i++)
+        if (b->cell[i])
+            score += 3;
+    return score;
+}
+
+/* Largest number of moves search() can generate in one position */
+#define MAX_CHILDREN (NUM_CELLS * NUM_STACKS + \
+                      NUM_STACKS * (STACK_MAX_CARDS * NUM_STACKS + 1))
+
+struct child {
+    int score;
+    struct move move;
+};
+
+static unsigned add_child(struct child *children, unsigned n,
+                          const struct board *b, uint8_t src, uint8_t dst,
+                          uint8_t count)
+{
+    struct board next = *b;
+    struct child c;
+    unsigned i;
+
+    c.move.src = src;
+    c.move.dst = dst;
+    c.move.count = count;
+    apply_move(&next, &c.move);
+    c.score = board_score(&next);
+
+    /* Insertion sort, stable so ties keep generation order */
+    for (i = n; i > 0 && children[i-1].score > c.score; i--)
+        children[i] = children[i-1];
+    children[i] = c;
+    return n + 1;
+}
+
+static bool search(struct solver *s, const struct board *b, unsigned depth)
+{
+    struct solution *sol = s->sol;
+    struct child children[MAX_CHILDREN];
+    struct board next;
+    unsigned n = 0;
+    unsigned k;
+    int first_empty = -1;
+    int first_cell = -1;
+    uint8_t run, count;
+    card_t card;
+    struct board_key key;
+    int i, j;
+
+    if (board_empty(b)) {
+        sol->solved = true;
+        sol->length = depth;
+        return true;
+    }
+    if (depth == SOLVER_MAX_MOVES || sol->gave_up)
+        return false;
+    board_key(b, &key);
+    if (!table_insert(s, &key))
+        return false;
+    if (s->max_nodes && sol->nodes >= s->max_nodes) {
+        sol->gave_up = true;
+        return false;
+    }
+    sol->nodes++;
+
+    /* Empty stacks and cells are interchangeable, so only try the first */
+    for (i = 0; i < NUM_STACKS; i++) {
+        if (!b->height[i]) {
+            first_empty = i;
+            break;
+        }
+    }
+    for (i = 0; i < NUM_CELLS; i++) {
+        if (!b->cell[i]) {
+            first_cell = i;
+            break;
+        }
+    }
+
+    /* Out of a cell onto a stack */
+    for (i = 0; i < NUM_CELLS; i++) {
+        card = b->cell[i];
+        if (!card)
+            continue;
+        for (j = 0; j < NUM_STACKS; j++) {
+            if (!b->height[j] && j != first_empty)
+                continue;
+            if (can_stack(b, j, card, 1))
+                n = add_child(children, n, b, NUM_STACKS + i, j, 1);
+        }
+    }
+
+    for (i = 0; i < NUM_STACKS; i++) {
+        run = run_length(b, i);
+
+        for (count = 1; count <= run; count++) {
+            card = b->stack[i][b->height[i] - count];
+
+            /* Onto another stack */
+            for (j = 0; j < NUM_STACKS; j++) {
+                if (j == i || !b->height[j])
+                    continue;
+                if (can_stack(b, j, card, count))
+                    n = add_child(children, n, b, i, j, count);
+            }
+
+            /* Onto an empty stack, unless that would just move the whole stack */
+            if (first_empty >= 0 && count < b->height[i])
+                n = add_child(children, n, b, i, first_empty, count);
+        }
+
+        /* Into a free cell */
+        if (run && first_cell >= 0)
+            n = add_child(children, n, b, i, NUM_STACKS + first_cell, 1);
+    }
+
+    for (k = 0; k < n; k++) {
+        next = *b;
+        apply_move(&next, &children[k].move);
+        sol->moves[depth] = children[k].move;
+        if (search(s, &next, depth + 1))
+            return true;
+    }
+
+    return false;
+}
+
+void solve(struct solver *s, const struct board *b, struct solution *sol)
+{
+    /* Drop back to the initial size rather than clear a big table */
+    if (s->mask + 1 > TABLE_INITIAL) {
+        free(s->table);
+        free(s->keys);
+        s->table = calloc(TABLE_INITIAL, sizeof(*s->table));
+        s->keys = malloc(TABLE_INITIAL / 2 * sizeof(*s->keys));
+        if (!s->table || !s->keys)
+            abort();
+        s->mask = TABLE_INITIAL - 1;
+    } else {
+        memset(s->table, 0, TABLE_INITIAL * sizeof(*s->table));
+    }
+    s->used = 0;
+    s->sol = sol;
+    sol->solved = false;
+    sol->gave_up = false;
+    sol->nodes = 0;
+    sol->length = 0;
+    search(s, b, 0);
+}
@@ -0,0 +1,77 @@
+#ifndef _SOLVER_H_
+#define _SOLVER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "game.h"
+
+/*
+ * Host side solver for the rules in game.c: moving a run of descending
+ * alternating cards onto an empty stack or a card one higher of another
+ * color (never a dragon onto a stack that has cards), or a single card
+ * into an empty free cell, with the automatic moves of check_moves()
+ * applied after every move.
+ */
+
+#define SOLVER_MAX_MOVES    256
+
+struct board {
+    card_t stack[NUM_STACKS][STACK_MAX_CARDS];
+    uint8_t height[NUM_STACKS];
+    card_t cell[NUM_CELLS];
+    uint8_t done[3];    /* Highest number on each suit's done pile */
+};
+
+/*
+ * A player move, in the terms of take_run()/drop_run(): 0 to NUM_STACKS-1
+ * are stacks, NUM_STACKS onwards are free cells.
+ */
+struct move {
+    uint8_t src;
+    uint8_t dst;
+    uint8_t count;  /* Cards moved, from the top of src */
+};
+
+struct solution {
+    bool solved;
+    bool gave_up;           /* Hit the node limit, so solvability is unknown */
+    unsigned long nodes;    /* Positions expanded */
+    unsigned length;
+    struct move moves[SOLVER_MAX_MOVES];
+};
+
+struct solver;
+
+/* A solver gives up after max_nodes positions, 0 for no limit */
+struct solver *solver_new(unsigned long max_nodes);
+void solver_free(struct solver *s);
+
+/* Lay out a deck from make_deck() the way cards() deals it */
+void board_deal(struct board *b, const card_t *deck);
+
+/* Make the automatic moves check_moves() would */
+void board_auto_moves(struct board *b);
+
+bool board_empty(const struct board *b);
+
+/*
+ * Key identifying a position up to the order of the stacks and of the free
+ * cells: the cards of each stack, each stack ended by a 0, the stacks in
+ * sorted order, then the cells sorted, 6 bits a card. The done piles need
+ * no part in it: they follow from which cards are left.
+ */
+#define BOARD_KEY_CARDS     (DECK_SIZE + NUM_STACKS + NUM_CELLS)
+#define BOARD_KEY_PER_WORD  10
+#define BOARD_KEY_WORDS     ((BOARD_KEY_CARDS + BOARD_KEY_PER_WORD - 1) / BOARD_KEY_PER_WORD)
+
+struct board_key {
+    uint64_t word[BOARD_KEY_WORDS];
+};
+
+void board_key(const struct board *b, struct board_key *key);
+
+/* Search for a solution from b, which must already have had its auto moves */
+void solve(struct solver *s, const struct board *b, struct solution *sol);
+
+#endif